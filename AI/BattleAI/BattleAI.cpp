@@ -11,6 +11,7 @@
 #include "BattleAI.h"
 #include "StackWithBonuses.h"
 #include "EnemyInfo.h"
+#include "../../lib/CThreadHelper.h"
 #include "../../lib/spells/CSpellHandler.h"
 
 #define LOGL(text) print(text)
@@ -46,6 +47,9 @@ BattleAction CBattleAI::activeStack( const CStack * stack )
 {
 	LOG_TRACE_PARAMS(logAi, "stack: %s", stack->nodeName())	;
 	setCbc(cb); //TODO: make solid sure that AIs always use their callbacks (need to take care of event handlers too)
+
+	auto cacheStats = cb->getReachabilityCacheStats();
+	logAi->trace("Reachability cache so far: %d hits, %d misses", cacheStats.hits, cacheStats.misses);
 	try
 	{
 		if(stack->type->idNumber == CreatureID::CATAPULT)
@@ -79,7 +83,7 @@ BattleAction CBattleAI::activeStack( const CStack * stack )
 		PotentialTargets targets(stack);
 		if(targets.possibleAttacks.size())
 		{
-			auto hlp = targets.bestAction();
+			auto hlp = targets.bestAction(threatMap);
 			if(hlp.attack.shooting)
 				return BattleAction::makeShotAttack(stack, hlp.enemy);
 			else
@@ -89,7 +93,6 @@ BattleAction CBattleAI::activeStack( const CStack * stack )
 		{
 			if(stack->waited())
 			{
-				//ThreatMap threatsToUs(stack); // These lines may be usefull but they are't used in the code.
 				auto dists = getCbc()->battleGetDistances(stack);
 				const EnemyInfo &ei= *range::min_element(targets.unreachableEnemies, std::bind(isCloser, _1, _2, std::ref(dists)));
 				if(distToNearestNeighbour(ei.s->position, dists) < GameConstants::BFIELD_SIZE)
@@ -216,6 +219,15 @@ void CBattleAI::attemptCastingSpell()
 	if(possibleCasts.empty())
 		return;
 
+	//spells are evaluated by many threads, values computed lazily are filled before they start
+	if(!AttackPossibility::priorities)
+		AttackPossibility::priorities = new Priorities();
+	for(auto stack : cb->battleGetStacks())
+	{
+		stack->shots.total();
+		stack->counterAttacks.total();
+	}
+
 	std::map<const CStack*, int> valueOfStack;
 	for(auto stack : cb->battleGetStacks())
 	{
@@ -257,16 +269,17 @@ void CBattleAI::attemptCastingSpell()
 			int totalGain = 0;
 			for(const CStack * sta : stacksAffected)
 			{
-				StackWithBonuses swb;
-				swb.stack = sta;
+				StackWithBonuses swb(sta);
 				//todo: handle effect actualization in HypotheticChangesToBattleState
-				ps.spell->getEffects(swb.bonusesToAdd, skillLevel, false, hero->getEnchantPower(ps.spell));
-				ps.spell->getEffects(swb.bonusesToAdd, skillLevel, true, hero->getEnchantPower(ps.spell));
+				std::vector<Bonus> effects;
+				ps.spell->getEffects(effects, skillLevel, false, hero->getEnchantPower(ps.spell));
+				ps.spell->getEffects(effects, skillLevel, true, hero->getEnchantPower(ps.spell));
+				swb.addBonuses(effects);
 				HypotheticChangesToBattleState state;
 				state.bonusesOfStacks[swb.stack] = &swb;
 				PotentialTargets pt(swb.stack, state);
 				auto newValue = pt.bestActionValue();
-				auto oldValue = valueOfStack[swb.stack];
+				auto oldValue = getValOr(valueOfStack, swb.stack, 0);
 				auto gain = newValue - oldValue;
 				if(swb.stack->owner != playerID) //enemy
 					gain = -gain;
@@ -284,8 +297,7 @@ void CBattleAI::attemptCastingSpell()
 		}
 	};
 
-	for(PossibleSpellcast & psc : possibleCasts)
-		psc.value = evaluateSpellcast(psc);
+	evaluateSpellcasts(possibleCasts, evaluateSpellcast);
 	auto pscValue = [] (const PossibleSpellcast &ps) -> int
 	{
 		return ps.value;
@@ -301,6 +313,46 @@ void CBattleAI::attemptCastingSpell()
 	cb->battleMakeAction(&spellcast);
 }
 
+void CBattleAI::evaluateSpellcasts(std::vector<PossibleSpellcast> & casts, std::function<int(const PossibleSpellcast &)> evaluator) const
+{
+	const int threads = std::min<int>(casts.size(), std::max<int>(boost::thread::hardware_concurrency(), 1));
+	if(threads < 2)
+	{
+		for(PossibleSpellcast & psc : casts)
+			psc.value = evaluator(psc);
+		return;
+	}
+
+	//battle doesn't change until we make our action, so all threads read the same state
+	//every cast keeps its own value and best one is chosen afterwards, so result doesn't depend on number of threads
+	std::vector<std::exception_ptr> errors(casts.size());
+	std::vector<Task> tasks;
+	for(size_t i = 0; i < casts.size(); i++)
+	{
+		tasks.push_back([&, i]()
+		{
+			setThreadName("CBattleAI::evaluateSpellcasts");
+			try
+			{
+				casts[i].value = evaluator(casts[i]);
+			}
+			catch(...)
+			{
+				errors[i] = std::current_exception();
+			}
+		});
+	}
+
+	CThreadHelper helper(&tasks, threads);
+	helper.run();
+
+	for(auto & error : errors)
+	{
+		if(error)
+			std::rethrow_exception(error);
+	}
+}
+
 std::vector<BattleHex> CBattleAI::getTargetsToConsider(const CSpell * spell, const ISpellCaster * caster) const
 {
 	const CSpell::TargetInfo targetInfo(spell, caster->getSpellSchoolLevel(spell));
@@ -372,6 +424,7 @@ void CBattleAI::battleStart(const CCreatureSet *army1, const CCreatureSet *army2
 {
 	print("battleStart called");
 	side = Side;
+	threatMap.reset(cb.get());
 }
 
 bool CBattleAI::isCloser(const EnemyInfo &ei1, const EnemyInfo &ei2, const ReachabilityInfo::TDistances &dists)
@@ -10,6 +10,7 @@
 #pragma once
 #include "../../lib/AI_Base.h"
 #include "PotentialTargets.h"
+#include "ThreatMap.h"
 
 class CSpell;
 class EnemyInfo;
@@ -56,6 +57,7 @@ class CBattleAI : public CBattleGameInterface
 {
 	int side;
 	std::shared_ptr<CBattleCallback> cb;
+	ThreatMap threatMap; //kept between activations, updated only for changed stacks
 
 	//Previous setting of cb
 	bool wasWaitingForRealize, wasUnlockingGs;
@@ -66,6 +68,8 @@ public:
 
 	void init(std::shared_ptr<CBattleCallback> CB) override;
 	void attemptCastingSpell();
+	/// Sets value of every cast, casts are evaluated by worker threads
+	void evaluateSpellcasts(std::vector<PossibleSpellcast> & casts, std::function<int(const PossibleSpellcast &)> evaluator) const;
 
 	BattleAction activeStack(const CStack * stack) override; //called when it's turn of that stack
 	BattleAction goTowards(const CStack * stack, BattleHex hex );
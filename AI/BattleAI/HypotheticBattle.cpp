@@ -0,0 +1,421 @@
+/*
+ * HypotheticBattle.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+#include "HypotheticBattle.h"
+#include "StackWithBonuses.h"
+#include "../../lib/CCreatureHandler.h"
+#include "../../lib/CModHandler.h"
+#include "../../lib/VCMI_Lib.h"
+#include "../../lib/battle/BattleAttackInfo.h"
+#include "../../lib/battle/CBattleInfoCallback.h"
+#include "../../lib/battle/CObstacleInstance.h"
+#include "../../lib/mapObjects/CGHeroInstance.h"
+
+HypotheticBattle::Unit::Unit(const CStack * Stack):
+	stack(Stack),
+	position(Stack->position),
+	health(Stack->health),
+	shots(Stack->shots.available()),
+	retaliations(Stack->counterAttacks.available()),
+	moved(Stack->moved()),
+	waited(Stack->waited()),
+	defending(false)
+{
+}
+
+bool HypotheticBattle::Unit::alive() const
+{
+	return health.getCount() > 0;
+}
+
+bool HypotheticBattle::Unit::ableToRetaliate() const
+{
+	return alive()
+		&& (retaliations > 0 || stack->hasBonusOfType(Bonus::UNLIMITED_RETALIATIONS))
+		&& !stack->hasBonusOfType(Bonus::SIEGE_WEAPON)
+		&& !stack->hasBonusOfType(Bonus::HYPNOTIZED)
+		&& !stack->hasBonusOfType(Bonus::NO_RETALIATION);
+}
+
+HypotheticBattle::HypotheticBattle(const CBattleInfoCallback * Cb, ui64 seed):
+	cb(Cb),
+	randomState(seed),
+	roundsPassed(0),
+	luckBlocked(false)
+{
+	auto accessibility = std::make_shared<AccessibilityInfo>(cb->getAccesibility());
+	for(const CStack * stack : cb->battleGetAllStacks())
+	{
+		if(!stack->alive() || !stack->position.isValid())
+			continue;
+
+		units.push_back(Unit(stack));
+		for(BattleHex hex : stack->getHexes())
+		{
+			if(hex.isAvailable())
+				(*accessibility)[hex] = EAccessibility::ACCESSIBLE;
+		}
+		if(NBonus::hasOfType(stack->getMyHero(), Bonus::BLOCK_LUCK))
+			luckBlocked = true;
+	}
+	terrain = accessibility;
+
+	const BattlePerspective::BattlePerspective perspective = cb->battleGetMySide();
+	for(auto & obstacle : cb->battleGetAllObstacles(perspective))
+	{
+		if(!cb->battleIsObstacleVisibleForSide(*obstacle, perspective))
+			continue;
+
+		for(BattleHex hex : obstacle->getStoppingTile())
+		{
+			if(hex.isValid())
+				stoppers[hex] = true;
+		}
+	}
+
+	const JsonNode & settings = VLC->modh->settings.data;
+	negativeLuck = settings["hardcodedFeatures"]["NEGATIVE_LUCK"].Bool();
+}
+
+const std::vector<HypotheticBattle::Unit> & HypotheticBattle::getUnits() const
+{
+	return units;
+}
+
+const HypotheticBattle::Unit * HypotheticBattle::getUnit(ui32 stackID) const
+{
+	for(auto & unit : units)
+	{
+		if(unit.stack->ID == stackID)
+			return &unit;
+	}
+	return nullptr;
+}
+
+HypotheticBattle::Unit * HypotheticBattle::getUnit(ui32 stackID)
+{
+	return const_cast<Unit *>(static_cast<const HypotheticBattle *>(this)->getUnit(stackID));
+}
+
+const HypotheticBattle::Unit * HypotheticBattle::getUnitAt(BattleHex hex) const
+{
+	for(auto & unit : units)
+	{
+		if(!unit.alive())
+			continue;
+		if(unit.position == hex || (unit.stack->doubleWide() && unit.stack->occupiedHex(unit.position) == hex))
+			return &unit;
+	}
+	return nullptr;
+}
+
+const HypotheticBattle::Unit * HypotheticBattle::getActiveUnit() const
+{
+	//waiting units move after all others, slowest first
+	auto movesBefore = [](const Unit & first, const Unit & second) -> bool
+	{
+		if(first.waited != second.waited)
+			return second.waited;
+
+		const ui32 firstSpeed = first.stack->Speed(), secondSpeed = second.stack->Speed();
+		if(firstSpeed != secondSpeed)
+			return first.waited ? firstSpeed < secondSpeed : firstSpeed > secondSpeed;
+		if(first.stack->side != second.stack->side)
+			return first.stack->side == BattleSide::ATTACKER;
+		return first.stack->ID < second.stack->ID;
+	};
+
+	const Unit * ret = nullptr;
+	for(auto & unit : units)
+	{
+		if(!unit.alive() || unit.moved || unit.stack->hasBonusOfType(Bonus::NOT_ACTIVE))
+			continue;
+		if(!ret || movesBefore(unit, *ret))
+			ret = &unit;
+	}
+	return ret;
+}
+
+ReachabilityInfo::TDistances HypotheticBattle::getDistances(ui32 stackID) const
+{
+	ReachabilityInfo::TDistances ret;
+	ret.fill(ReachabilityInfo::INFINITE_DIST);
+
+	const Unit * unit = getUnit(stackID);
+	if(!unit || !unit->alive())
+		return ret;
+
+	AccessibilityInfo accessibility = *terrain;
+	for(auto & other : units)
+	{
+		if(&other == unit || !other.alive())
+			continue;
+
+		for(BattleHex hex : CStack::getHexes(other.position, other.stack->doubleWide(), other.stack->side))
+		{
+			if(hex.isAvailable())
+				accessibility[hex] = EAccessibility::ALIVE_STACK;
+		}
+	}
+	const THexMask accessibleHexes = accessibility.getAccessibleHexes(unit->stack->doubleWide(), unit->stack->side);
+
+	if(unit->stack->hasBonusOfType(Bonus::FLYING))
+	{
+		for(int i = 0; i < GameConstants::BFIELD_SIZE; i++)
+		{
+			if(accessibleHexes[i])
+				ret[i] = BattleHex::getDistance(unit->position, i);
+		}
+		return ret;
+	}
+
+	ReachabilityInfo::TPredecessors predecessors;
+	ReachabilityInfo::walk(unit->position, accessibleHexes, stoppers, ret, predecessors);
+	return ret;
+}
+
+bool HypotheticBattle::canShoot(ui32 stackID) const
+{
+	const Unit * unit = getUnit(stackID);
+	if(!unit || !unit->alive() || unit->shots <= 0 || !unit->stack->hasBonusOfType(Bonus::SHOOTER))
+		return false;
+
+	if(unit->stack->valOfBonuses(Bonus::FORGETFULL) > 1)
+		return false;
+	if(unit->stack->getCreature()->idNumber == CreatureID::CATAPULT)
+		return false;
+
+	return !isBlocked(*unit) || unit->stack->hasBonusOfType(Bonus::FREE_SHOOTING);
+}
+
+boost::optional<int> HypotheticBattle::getWinner() const
+{
+	bool hasStack[2] = {false, false};
+	for(auto & unit : units)
+	{
+		if(unit.alive() && !unit.stack->hasBonusOfType(Bonus::SIEGE_WEAPON))
+			hasStack[unit.stack->side] = true;
+	}
+
+	if(!hasStack[0] && !hasStack[1])
+		return 2;
+	if(!hasStack[1])
+		return 0;
+	if(!hasStack[0])
+		return 1;
+	return boost::none;
+}
+
+si64 HypotheticBattle::getArmyValue(ui8 side) const
+{
+	si64 ret = 0;
+	for(auto & unit : units)
+	{
+		if(unit.alive() && unit.stack->side == side)
+			ret += unit.stack->getCreature()->AIValue * unit.health.available() / unit.stack->unitMaxHealth();
+	}
+	return ret;
+}
+
+int HypotheticBattle::getRoundsPassed() const
+{
+	return roundsPassed;
+}
+
+void HypotheticBattle::setSeed(ui64 seed)
+{
+	randomState = seed;
+}
+
+void HypotheticBattle::makeMove(ui32 stackID, BattleHex destination)
+{
+	Unit * unit = startAction(stackID);
+	if(!unit)
+		return;
+
+	unit->position = destination;
+	unit->moved = true;
+}
+
+void HypotheticBattle::makeMeleeAttack(ui32 stackID, ui32 targetID, BattleHex from)
+{
+	Unit * attacker = startAction(stackID);
+	Unit * defender = getUnit(targetID);
+	if(!attacker || !defender)
+		return;
+
+	const BattleHex startingPos = attacker->position;
+	int distance = 0;
+	if(from != startingPos)
+	{
+		distance = getDistances(stackID)[from];
+		if(distance == ReachabilityInfo::INFINITE_DIST)
+			distance = 0;
+		attacker->position = from;
+	}
+	attacker->moved = true;
+
+	//all unspecified attacks + melee attacks
+	const int totalAttacks = 1 + attacker->stack->getBonuses(Selector::type(Bonus::ADDITIONAL_ATTACK),
+		Selector::effectRange(Bonus::NO_LIMIT).Or(Selector::effectRange(Bonus::ONLY_MELEE_FIGHT)))->totalValue();
+
+	for(int i = 0; i < totalAttacks; i++)
+	{
+		if(attacker->alive() && defender->alive())
+			attack(*attacker, *defender, false, i ? 0 : distance, false); //no distance travelled on second attack
+
+		if(i == 0
+			&& !attacker->stack->hasBonusOfType(Bonus::BLOCKS_RETALIATION)
+			&& defender->ableToRetaliate()
+			&& attacker->alive())
+		{
+			attack(*defender, *attacker, false, 0, true);
+		}
+	}
+
+	if(attacker->stack->hasBonusOfType(Bonus::RETURN_AFTER_STRIKE) && attacker->alive())
+		attacker->position = startingPos;
+}
+
+void HypotheticBattle::makeShot(ui32 stackID, ui32 targetID)
+{
+	Unit * attacker = startAction(stackID);
+	Unit * defender = getUnit(targetID);
+	if(!attacker || !defender)
+		return;
+
+	attacker->moved = true;
+	attack(*attacker, *defender, true, 0, false);
+
+	if(defender->stack->hasBonusOfType(Bonus::RANGED_RETALIATION)
+		&& !attacker->stack->hasBonusOfType(Bonus::BLOCKS_RANGED_RETALIATION)
+		&& defender->ableToRetaliate()
+		&& attacker->alive())
+	{
+		attack(*defender, *attacker, true, 0, true);
+	}
+
+	const int additionalAttacks = attacker->stack->getBonuses(Selector::type(Bonus::ADDITIONAL_ATTACK),
+		Selector::effectRange(Bonus::NO_LIMIT).Or(Selector::effectRange(Bonus::ONLY_DISTANCE_FIGHT)))->totalValue();
+
+	for(int i = 0; i < additionalAttacks; i++)
+	{
+		if(attacker->alive() && defender->alive() && attacker->shots > 0)
+			attack(*attacker, *defender, true, 0, false);
+	}
+}
+
+void HypotheticBattle::makeWait(ui32 stackID)
+{
+	if(Unit * unit = startAction(stackID))
+		unit->waited = true;
+}
+
+void HypotheticBattle::makeDefend(ui32 stackID)
+{
+	if(Unit * unit = startAction(stackID))
+	{
+		unit->defending = true;
+		unit->moved = true;
+	}
+}
+
+void HypotheticBattle::nextRound()
+{
+	for(auto & unit : units)
+	{
+		unit.moved = unit.waited = false;
+		unit.retaliations = unit.stack->counterAttacks.total();
+	}
+	roundsPassed++;
+}
+
+HypotheticBattle::Unit * HypotheticBattle::startAction(ui32 stackID)
+{
+	Unit * unit = getUnit(stackID);
+	if(unit)
+		unit->defending = false;
+	return unit;
+}
+
+bool HypotheticBattle::hasAmmoCart(const Unit & unit) const
+{
+	return vstd::contains_if(units, [&](const Unit & other)
+	{
+		return other.alive() && other.stack->owner == unit.stack->owner && other.stack->getCreature()->idNumber == CreatureID::AMMO_CART;
+	});
+}
+
+bool HypotheticBattle::isBlocked(const Unit & unit) const
+{
+	if(unit.stack->hasBonusOfType(Bonus::SIEGE_WEAPON)) //siege weapons cannot be blocked
+		return false;
+
+	for(BattleHex hex : unit.stack->getSurroundingHexes(unit.position))
+	{
+		const Unit * neighbour = getUnitAt(hex);
+		if(neighbour && neighbour->stack->owner != unit.stack->owner)
+			return true;
+	}
+	return false;
+}
+
+si32 HypotheticBattle::nextInt(si32 lower, si32 upper)
+{
+	//splitmix64, state is just one number so copies of battle stay cheap
+	randomState += 0x9E3779B97F4A7C15ULL;
+	ui64 value = randomState;
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	value ^= value >> 31;
+	return lower + static_cast<si32>(value % (static_cast<ui64>(upper - lower) + 1));
+}
+
+void HypotheticBattle::attack(Unit & attacker, Unit & defender, bool shooting, int distance, bool counter)
+{
+	StackWithBonuses defenderBonuses(defender.stack);
+	if(defender.defending)
+	{
+		//same bonuses as server gives for defensive stance
+		std::vector<Bonus> stance;
+		stance.push_back(Bonus(Bonus::STACK_GETS_TURN, Bonus::PRIMARY_SKILL, Bonus::OTHER, 20, -1, PrimarySkill::DEFENSE, Bonus::PERCENT_TO_ALL));
+		stance.push_back(Bonus(Bonus::STACK_GETS_TURN, Bonus::PRIMARY_SKILL, Bonus::OTHER, defender.stack->valOfBonuses(Bonus::DEFENSIVE_STANCE),
+			-1, PrimarySkill::DEFENSE, Bonus::ADDITIVE_VALUE));
+		defenderBonuses.addBonuses(stance);
+	}
+
+	BattleAttackInfo bai(attacker.stack, defender.stack, shooting);
+	bai.defenderBonuses = &defenderBonuses;
+	bai.attackerPosition = attacker.position;
+	bai.defenderPosition = defender.position;
+	bai.attackerHealth = attacker.health;
+	bai.defenderHealth = defender.health;
+	bai.chargedFields = distance;
+
+	const int attackerLuck = attacker.stack->LuckVal();
+	if(!luckBlocked)
+	{
+		if(attackerLuck > 0 && nextInt(0, 23) < attackerLuck)
+			bai.luckyHit = true;
+		if(negativeLuck && attackerLuck < 0 && nextInt(0, 23) < std::abs(attackerLuck))
+			bai.unluckyHit = true;
+	}
+	if(nextInt(0, 99) < attacker.stack->valOfBonuses(Bonus::DOUBLE_DAMAGE_CHANCE))
+		bai.deathBlow = true;
+
+	const TDmgRange range = cb->calculateDmgRange(bai);
+	int32_t damage = nextInt(range.first, std::max(range.first, range.second));
+	defender.health.damage(damage);
+
+	if(counter)
+		attacker.retaliations--;
+	if(shooting && !hasAmmoCart(attacker))
+		attacker.shots--;
+}
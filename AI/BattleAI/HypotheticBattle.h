@@ -0,0 +1,88 @@
+/*
+ * HypotheticBattle.h, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#pragma once
+#include "../../lib/CStack.h"
+#include "../../lib/battle/ReachabilityInfo.h"
+
+class CBattleInfoCallback;
+
+/// Copy of the parts of battle that are changed by stack actions, used to simulate actions without server
+///
+/// Rules of moving, melee attacks and shots follow CGameHandler::makeBattleAction and prepareAttack,
+/// random rolls come from own generator so same seed always gives same result.
+/// Bonuses (including active spell effects), obstacles and walls are taken from the real battle and are
+/// not changed by simulation, so are multi-hex attacks, spells and damage from moat or quicksands.
+/// Copying only copies vector of units, terrain accessibility is shared between copies.
+///
+/// Prototype covered by tests only: battle AI doesn't simulate with it until obstacles, siege walls
+/// and spell effects created or removed during simulation are modeled.
+class HypotheticBattle
+{
+public:
+	struct Unit
+	{
+		const CStack * stack;
+		BattleHex position;
+		CHealth health;
+		si32 shots;
+		si32 retaliations;
+		bool moved;
+		bool waited;
+		bool defending; //defensive stance taken in simulation, lasts until next action of unit
+
+		explicit Unit(const CStack * Stack);
+		bool alive() const;
+		bool ableToRetaliate() const;
+	};
+
+	HypotheticBattle(const CBattleInfoCallback * Cb, ui64 seed);
+
+	const std::vector<Unit> & getUnits() const;
+	const Unit * getUnit(ui32 stackID) const;
+	const Unit * getUnitAt(BattleHex hex) const;
+	/// Next unit to act in current round using speed and waiting, nullptr if round is over
+	const Unit * getActiveUnit() const;
+	/// Distances for unit standing on its hypothetical position, like CBattleInfoCallback::battleGetDistances
+	ReachabilityInfo::TDistances getDistances(ui32 stackID) const;
+	/// Shooting rules of CBattleInfoCallback::battleCanShoot for hypothetical positions and ammo
+	bool canShoot(ui32 stackID) const;
+	/// Winning side like CBattleInfoCallback::battleIsFinished
+	boost::optional<int> getWinner() const;
+	/// Sum of AI values of living creatures of side
+	si64 getArmyValue(ui8 side) const;
+	/// Number of rounds finished in simulation
+	int getRoundsPassed() const;
+
+	void setSeed(ui64 seed);
+	void makeMove(ui32 stackID, BattleHex destination);
+	void makeMeleeAttack(ui32 stackID, ui32 targetID, BattleHex from);
+	void makeShot(ui32 stackID, ui32 targetID);
+	void makeWait(ui32 stackID);
+	void makeDefend(ui32 stackID);
+	void nextRound();
+
+private:
+	const CBattleInfoCallback * cb;
+	std::shared_ptr<const AccessibilityInfo> terrain; //accessibility without stacks
+	THexMask stoppers; //quicksands known to our side
+	std::vector<Unit> units;
+	ui64 randomState;
+	int roundsPassed;
+	bool luckBlocked;
+	bool negativeLuck;
+
+	Unit * getUnit(ui32 stackID);
+	/// Unit that is about to act, its previous defensive stance ends
+	Unit * startAction(ui32 stackID);
+	bool hasAmmoCart(const Unit & unit) const;
+	bool isBlocked(const Unit & unit) const;
+	si32 nextInt(si32 lower, si32 upper); //both inclusive
+	void attack(Unit & attacker, Unit & defender, bool shooting, int distance, bool counter);
+};
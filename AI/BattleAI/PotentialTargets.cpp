@@ -69,3 +69,23 @@ AttackPossibility PotentialTargets::bestAction() const
 
 	return *vstd::maxElementByFun(possibleAttacks, [](const AttackPossibility &ap) { return ap.attackValue(); } );
 }
+
+AttackPossibility PotentialTargets::bestAction(ThreatMap & threats) const
+{
+	const int bestValue = bestActionValue();
+	std::vector<const AttackPossibility *> best;
+	for(const AttackPossibility & ap : possibleAttacks)
+		if(ap.attackValue() == bestValue)
+			best.push_back(&ap);
+
+	if(best.size() == 1)
+		return *best.front();
+
+	//threats are estimated only when there is a choice, first of equally threatened attacks wins as in bestAction()
+	const CStack * attacker = best.front()->attack.attacker;
+	const ThreatMap::TDamages & suffered = threats.getSufferedDamage(attacker);
+	return **vstd::minElementByFun(best, [&](const AttackPossibility * ap)
+	{
+		return suffered[ap->tile.isValid() ? ap->tile : attacker->position];
+	});
+}
@@ -9,6 +9,7 @@
  */
 #pragma once
 #include "AttackPossibility.h"
+#include "ThreatMap.h"
 
 class PotentialTargets
 {
@@ -22,5 +23,7 @@ public:
 	PotentialTargets(const CStack *attacker, const HypotheticChangesToBattleState &state = HypotheticChangesToBattleState());
 
 	AttackPossibility bestAction() const;
+	/// Same as bestAction, but equally valued attacks are told apart by damage we would suffer on hex we attack from
+	AttackPossibility bestAction(ThreatMap & threats) const;
 	int bestActionValue() const;
 };
@@ -12,12 +12,10 @@
 
 class CStack;
 
-class StackWithBonuses : public IBonusBearer
+class StackWithBonuses : public CBonusOverlay
 {
 public:
 	const CStack *stack;
-	mutable std::vector<Bonus> bonusesToAdd;
 
-	virtual const TBonusListPtr getAllBonuses(const CSelector &selector, const CSelector &limit,
-						  const CBonusSystemNode *root = nullptr, const std::string &cachingStr = "") const override;
+	explicit StackWithBonuses(const CStack * Stack);
 };
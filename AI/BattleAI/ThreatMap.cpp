@@ -8,66 +8,163 @@
  *
  */
 #include "StdInc.h"
-/*
 #include "ThreatMap.h"
-#include "StdInc.h"
+#include "../../lib/CCreatureHandler.h"
+
+ThreatMap::Signature::Signature():
+	health(0), bonuses(0)
+{
+}
+
+ThreatMap::Signature::Signature(const CStack * stack):
+	position(stack->position),
+	health(stack->health.available()),
+	bonuses(stack->getTreeVersion())
+{
+}
+
+bool ThreatMap::Signature::operator==(const Signature & other) const
+{
+	return position == other.position && health == other.health && bonuses == other.bonuses;
+}
+
+ThreatMap::ThreatMap():
+	cb(nullptr)
+{
+}
+
+void ThreatMap::reset(const CBattleInfoCallback * battle)
+{
+	cb = battle;
+	attackers.clear();
+	damages.clear();
+	suffered.clear();
+}
 
-template <typename Container, typename Pred>
-auto sum(const Container & c, Pred p) -> decltype(p(*std::begin(c)))
+std::vector<BattleAttackInfo> ThreatMap::getThreats(const CStack * endangered, BattleHex hex)
 {
-	double ret = 0;
-	for(const auto &element : c)
+	std::vector<BattleAttackInfo> ret;
+	if(!hex.isValid())
+		return ret;
+
+	for(const CStack * enemy : getEnemies(endangered))
 	{
-		ret += p(element);
+		const Attacker & attacker = getAttacker(enemy);
+		if(attacker.attackable[hex])
+			ret.push_back(getAttackInfo(enemy, endangered, hex, attacker.shooting));
 	}
-
 	return ret;
 }
-ThreatMap::ThreatMap(const CStack *Endangered) : endangered(Endangered)
+
+const ThreatMap::TDamages & ThreatMap::getSufferedDamage(const CStack * endangered)
 {
-	sufferedDamage.fill(0);
+	const auto enemies = getEnemies(endangered);
+	std::vector<std::pair<ui32, Signature>> sources;
+	sources.push_back(std::make_pair(endangered->ID, Signature(endangered)));
+	for(const CStack * enemy : enemies)
+		sources.push_back(std::make_pair(enemy->ID, Signature(enemy)));
 
-	for(const CStack *enemy : getCbc()->battleGetStacks())
-	{
-		//Consider only stacks of different owner
-		if(enemy->side == endangered->side)
-			continue;
+	const ui32 stateVersion = cb->battleGetStateVersion();
+	auto it = suffered.find(endangered->ID);
+	if(it != suffered.end() && it->second.stateVersion == stateVersion && it->second.sources == sources)
+		return it->second.damages;
 
-		//Look-up which tiles can be melee-attacked
-		std::array<bool, GameConstants::BFIELD_SIZE> meleeAttackable;
-		meleeAttackable.fill(false);
-		auto enemyReachability = getCbc()->getReachability(enemy);
+	Suffered & entry = suffered[endangered->ID];
+	entry.stateVersion = stateVersion;
+	entry.sources = sources;
+	entry.damages.fill(0);
+	for(const CStack * enemy : enemies)
+	{
+		const Attacker & attacker = getAttacker(enemy);
 		for(int i = 0; i < GameConstants::BFIELD_SIZE; i++)
 		{
-			if(enemyReachability.isReachable(i))
-			{
-				meleeAttackable[i] = true;
-				for(auto n : BattleHex(i).neighbouringTiles())
-					meleeAttackable[n] = true;
-			}
+			if(attacker.attackable[i])
+				entry.damages[i] += getDamage(enemy, endangered, i, attacker.shooting);
 		}
+	}
+	return entry.damages;
+}
 
-		//Gather possible assaults
-		for(int i = 0; i < GameConstants::BFIELD_SIZE; i++)
-		{
-			if(getCbc()->battleCanShoot(enemy, i))
-				threatMap[i].push_back(BattleAttackInfo(enemy, endangered, true));
-			else if(meleeAttackable[i])
-			{
-				BattleAttackInfo bai(enemy, endangered, false);
-				bai.chargedFields = std::max(BattleHex::getDistance(enemy->position, i) - 1, 0); //TODO check real distance (BFS), not just metric
-				threatMap[i].push_back(BattleAttackInfo(bai));
-			}
-		}
+const ThreatMap::Attacker & ThreatMap::getAttacker(const CStack * enemy)
+{
+	const Signature signature(enemy);
+	const ui32 stateVersion = cb->battleGetStateVersion();
+	auto it = attackers.find(enemy->ID);
+	if(it != attackers.end() && it->second.stateVersion == stateVersion && it->second.signature == signature)
+		return it->second;
+
+	Attacker & attacker = attackers[enemy->ID];
+	attacker.signature = signature;
+	attacker.stateVersion = stateVersion;
+	attacker.attackable.reset();
+
+	//same as CBattleInfoCallback::battleCanShoot, but every hex may be target
+	attacker.shooting = enemy->canShoot()
+		&& !cb->battleTacticDist()
+		&& enemy->getCreature()->idNumber != CreatureID::CATAPULT
+		&& enemy->valOfBonuses(Bonus::FORGETFULL) <= 1
+		&& (!cb->battleIsStackBlocked(enemy) || enemy->hasBonusOfType(Bonus::FREE_SHOOTING));
+
+	if(attacker.shooting)
+	{
+		attacker.attackable.set();
+		return attacker;
 	}
 
+	//look-up which tiles can be melee-attacked
+	auto reachability = cb->getReachability(enemy);
 	for(int i = 0; i < GameConstants::BFIELD_SIZE; i++)
 	{
-		sufferedDamage[i] = sum(threatMap[i], [](const BattleAttackInfo &bai) -> int
+		if(!reachability.isReachable(i))
+			continue;
+
+		attacker.attackable[i] = true;
+		for(BattleHex neighbour : BattleHex(i).getAllNeighbouringTiles())
 		{
-			auto dmg = getCbc()->calculateDmgRange(bai);
-			return (dmg.first + dmg.second)/2;
-		});
+			if(neighbour.isValid())
+				attacker.attackable[neighbour] = true;
+		}
 	}
+	return attacker;
+}
+
+BattleAttackInfo ThreatMap::getAttackInfo(const CStack * enemy, const CStack * endangered, BattleHex hex, bool shooting) const
+{
+	BattleAttackInfo bai(enemy, endangered, shooting);
+	bai.defenderPosition = hex;
+	if(!shooting)
+		bai.chargedFields = std::max(BattleHex::getDistance(enemy->position, hex) - 1, 0); //TODO check real distance (BFS), not just metric
+	return bai;
+}
+
+int ThreatMap::getDamage(const CStack * enemy, const CStack * endangered, BattleHex hex, bool shooting)
+{
+	const Signature attackerSignature(enemy), endangeredSignature(endangered);
+	auto key = std::make_pair(enemy->ID, endangered->ID);
+	const bool known = vstd::contains(damages, key);
+	Damage & entry = damages[key];
+	if(!known || !(entry.attacker == attackerSignature) || !(entry.endangered == endangeredSignature))
+	{
+		entry.attacker = attackerSignature;
+		entry.endangered = endangeredSignature;
+		entry.damages[0].fill(-1);
+		entry.damages[1].fill(-1);
+	}
+
+	int & damage = entry.damages[shooting][hex];
+	if(damage < 0)
+	{
+		auto range = cb->calculateDmgRange(getAttackInfo(enemy, endangered, hex, shooting));
+		damage = (range.first + range.second) / 2;
+	}
+	return damage;
+}
+
+std::vector<const CStack *> ThreatMap::getEnemies(const CStack * endangered) const
+{
+	//consider only living stacks of different owner
+	return cb->battleGetStacksIf([=](const CStack * s)
+	{
+		return s->side != endangered->side && s->isValidTarget();
+	});
 }
-*/ // These lines may be usefull but they are't used in the code.
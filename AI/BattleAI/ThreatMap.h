@@ -7,19 +7,72 @@
  * Full text of license available in license.txt file, in main folder
  *
  */
-/*
 #pragma once
 
-#include "common.h"
-#include "CCallback.h"
-/*
+#include "../../lib/battle/BattleAttackInfo.h"
+#include "../../lib/battle/CBattleInfoCallback.h"
+
+/// Damage that our stack would suffer from enemies able to strike it on given hex
+///
+/// Kept between activations of AI. Hexes attackable by every enemy are recalculated only when the enemy
+/// or battle state changed and damage estimates are cached per (enemy, endangered) pair until position,
+/// health or bonuses of either stack change.
 class ThreatMap
 {
 public:
-	std::array<std::vector<BattleAttackInfo>, GameConstants::BFIELD_SIZE> threatMap; // [hexNr] -> enemies able to strike
+	typedef std::array<int, GameConstants::BFIELD_SIZE> TDamages;
+
+	ThreatMap();
+
+	/// Forgets everything and starts following given battle, should be called when new battle starts
+	void reset(const CBattleInfoCallback * battle);
+
+	/// Enemies able to strike endangered stack standing on hex
+	std::vector<BattleAttackInfo> getThreats(const CStack * endangered, BattleHex hex);
+	/// Sum of average damage from all enemies able to strike endangered stack on every hex
+	const TDamages & getSufferedDamage(const CStack * endangered);
+
+private:
+	/// Part of stack state that threats depend on
+	struct Signature
+	{
+		BattleHex position;
+		si64 health;
+		si64 bonuses; //tree version
+
+		Signature();
+		Signature(const CStack * stack);
+		bool operator==(const Signature & other) const;
+	};
+
+	struct Attacker
+	{
+		Signature signature;
+		ui32 stateVersion;
+		bool shooting;
+		THexMask attackable; //hexes where enemy may strike
+	};
+
+	struct Damage
+	{
+		Signature attacker, endangered;
+		TDamages damages[2]; //[shooting], -1 if not estimated yet
+	};
+
+	struct Suffered
+	{
+		ui32 stateVersion;
+		std::vector<std::pair<ui32, Signature>> sources; //endangered stack followed by all enemies
+		TDamages damages;
+	};
 
-	const CStack *endangered;
-	std::array<int, GameConstants::BFIELD_SIZE> sufferedDamage;
+	const CBattleInfoCallback * cb;
+	std::map<ui32, Attacker> attackers;
+	std::map<std::pair<ui32, ui32>, Damage> damages; //[enemy, endangered]
+	std::map<ui32, Suffered> suffered;
 
-	ThreatMap(const CStack *Endangered);
-};*/ // These lines may be usefull but they are't used in the code.
+	const Attacker & getAttacker(const CStack * enemy);
+	BattleAttackInfo getAttackInfo(const CStack * enemy, const CStack * endangered, BattleHex hex, bool shooting) const;
+	int getDamage(const CStack * enemy, const CStack * endangered, BattleHex hex, bool shooting);
+	std::vector<const CStack *> getEnemies(const CStack * endangered) const;
+};
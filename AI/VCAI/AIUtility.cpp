@@ -23,7 +23,7 @@
 
 extern boost::thread_specific_ptr<CCallback> cb;
 extern boost::thread_specific_ptr<VCAI> ai;
-extern FuzzyHelper *fh;
+extern boost::thread_specific_ptr<FuzzyHelper> fh;
 
 //extern static const int3 dirs[8];
 
@@ -126,6 +126,161 @@ const CGHeroInstance * HeroPtr::operator*() const
 	return get();
 }
 
+TimeBudget::TimeBudget()
+	: limited(false)
+{
+}
+
+TimeBudget::TimeBudget(si64 milliseconds)
+	: deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds)), limited(milliseconds > 0)
+{
+}
+
+bool TimeBudget::exceeded() const
+{
+	return limited && std::chrono::steady_clock::now() >= deadline;
+}
+
+DangerGrid::DangerGrid()
+	: sizes(0, 0, 0)
+{
+}
+
+DangerGrid::~DangerGrid() = default;
+
+void DangerGrid::reset(const std::set<const CGObjectInstance *> & objects)
+{
+	clear();
+	sizes = cb->getMapSize();
+	tiles.resize(sizes.x * sizes.y * sizes.z);
+
+	for(auto obj : objects)
+		addArmy(obj);
+}
+
+void DangerGrid::clear()
+{
+	sizes = int3(0, 0, 0);
+	tiles.clear();
+	heroAreas.clear();
+}
+
+void DangerGrid::addArmy(const CGObjectInstance * obj)
+{
+	if(tiles.empty())
+		return;
+
+	if(obj->ID == Obj::MONSTER)
+	{
+		updateGuards(obj->visitablePos());
+		foreach_neighbour(obj->visitablePos(), [&](const int3 & pos)
+		{
+			updateGuards(pos);
+		});
+	}
+	else if(obj->ID == Obj::HERO)
+	{
+		removeHero(obj->id);
+		if(cb->getPlayerRelations(obj->tempOwner, ai->playerID) == PlayerRelations::ENEMIES)
+			addHero(dynamic_cast<const CGHeroInstance *>(obj));
+	}
+}
+
+void DangerGrid::removeArmy(const CGObjectInstance * obj)
+{
+	if(tiles.empty())
+		return;
+
+	if(obj->ID == Obj::MONSTER)
+	{
+		updateGuards(obj->visitablePos(), obj);
+		foreach_neighbour(obj->visitablePos(), [&](const int3 & pos)
+		{
+			updateGuards(pos, obj);
+		});
+	}
+	else if(obj->ID == Obj::HERO)
+	{
+		removeHero(obj->id);
+	}
+}
+
+void DangerGrid::removeHero(ObjectInstanceID hero)
+{
+	auto it = heroAreas.find(hero);
+	if(it == heroAreas.end())
+		return;
+
+	const CGHeroInstance * h = it->second.first;
+	for(const int3 & tile : it->second.second)
+	{
+		vstd::erase_if(tiles[getTileIndex(tile)].heroes, [h](const std::pair<const CGHeroInstance *, ui64> & threat)
+		{
+			return threat.first == h;
+		});
+	}
+	heroAreas.erase(it);
+}
+
+void DangerGrid::updateTiles(const std::unordered_set<int3, ShashInt3> & changed)
+{
+	if(tiles.empty())
+		return;
+
+	for(const int3 & tile : changed)
+		updateGuards(tile);
+}
+
+const DangerGrid::Threat * DangerGrid::getThreat(const int3 & tile) const
+{
+	if(tiles.empty() || tile.x < 0 || tile.y < 0 || tile.z < 0 || tile.x >= sizes.x || tile.y >= sizes.y || tile.z >= sizes.z)
+		return nullptr;
+
+	return &tiles[getTileIndex(tile)];
+}
+
+ui32 DangerGrid::getTileIndex(const int3 & tile) const
+{
+	return (tile.z * sizes.y + tile.y) * sizes.x + tile.x;
+}
+
+void DangerGrid::updateGuards(const int3 & tile, const CGObjectInstance * removed)
+{
+	auto & guards = tiles[getTileIndex(tile)].guards;
+	guards.clear();
+	if(!cb->isVisible(tile))
+		return;
+
+	for(auto guard : cb->getGuardingCreatures(tile))
+	{
+		if(guard != removed)
+			guards.push_back(std::make_pair(guard, evaluateDanger(guard)));
+	}
+}
+
+void DangerGrid::addHero(const CGHeroInstance * hero)
+{
+	if(!paths || paths->sizes != sizes)
+		paths = make_unique<CPathsInfo>(sizes);
+	cb->calculatePaths(hero, *paths);
+
+	auto & area = heroAreas[hero->id];
+	area.first = hero;
+	const ui64 strength = evaluateDanger(hero);
+	for(ui32 i = 0; i < paths->getNodesCount(); i++)
+	{
+		const CGPathNode * node = paths->getNode(i);
+		if(!node || !node->reachable() || node->turns > 1)
+			continue;
+
+		auto & heroes = tiles[getTileIndex(node->coord)].heroes;
+		if(heroes.size() && heroes.back().first == hero)
+			continue; //tile was already reached on other layer
+		heroes.push_back(std::make_pair(hero, strength));
+		area.second.push_back(node->coord);
+	}
+}
+
 void foreach_tile_pos(std::function<void(const int3& pos)> foo)
 {
 	// some micro-optimizations since this function gets called a LOT
@@ -207,6 +362,17 @@ ui64 evaluateDanger(crint3 tile)
 	return std::max(objectDanger, guardDanger);
 }
 
+/// Guards of tile and their strength, taken from danger grid if it was computed, otherwise searched into storage
+static const std::vector<std::pair<const CGObjectInstance *, ui64>> & getGuards(crint3 tile, std::vector<std::pair<const CGObjectInstance *, ui64>> & storage)
+{
+	if(auto threat = ai->dangerGrid.getThreat(tile))
+		return threat->guards;
+
+	for (auto cre : cb->getGuardingCreatures(tile))
+		storage.push_back(std::make_pair(cre, evaluateDanger(cre)));
+	return storage;
+}
+
 ui64 evaluateDanger(crint3 tile, const CGHeroInstance *visitor)
 {
 	const TerrainTile *t = cb->getTile(tile, false);
@@ -214,6 +380,7 @@ ui64 evaluateDanger(crint3 tile, const CGHeroInstance *visitor)
 		return 190000000; //MUCH
 
 	ui64 objectDanger = 0, guardDanger = 0;
+	std::vector<std::pair<const CGObjectInstance *, ui64>> guardsStorage;
 
 	auto visitableObjects = cb->getVisitableObjs(tile);
 	// in some scenarios hero happens to be "under" the object (eg town). Then we consider ONLY the hero.
@@ -241,21 +408,34 @@ ui64 evaluateDanger(crint3 tile, const CGHeroInstance *visitor)
 			auto it = ai->knownSubterraneanGates.find(dangerousObject);
 			if (it != ai->knownSubterraneanGates.end())
 			{
-				auto guards = cb->getGuardingCreatures(it->second->visitablePos());
-				for (auto cre : guards)
+				for (auto & guard : getGuards(it->second->visitablePos(), guardsStorage))
 				{
-					vstd::amax (guardDanger, evaluateDanger(cre) *
-						fh->getTacticalAdvantage(visitor, dynamic_cast<const CArmedInstance*>(cre)));
+					vstd::amax (guardDanger, guard.second *
+						fh->getTacticalAdvantage(visitor, dynamic_cast<const CArmedInstance*>(guard.first)));
 				}
 			}
 		}
 	}
 
-	auto guards = cb->getGuardingCreatures(tile);
-	for (auto cre : guards)
-	{
-		vstd::amax (guardDanger, evaluateDanger(cre) * fh->getTacticalAdvantage(visitor, dynamic_cast<const CArmedInstance*>(cre))); //we are interested in strongest monster around
-	}
+	guardsStorage.clear();
+	auto & guards = getGuards(tile, guardsStorage);
+	auto threat = ai->dangerGrid.getThreat(tile);
+	static const std::vector<std::pair<const CGHeroInstance *, ui64>> noHeroes;
+	auto & heroes = threat ? threat->heroes : noHeroes;
+
+	std::vector<const CArmedInstance *> armies;
+	armies.reserve(guards.size() + heroes.size());
+	for (auto & guard : guards)
+		armies.push_back(dynamic_cast<const CArmedInstance*>(guard.first));
+	for (auto & hero : heroes)
+		armies.push_back(hero.first);
+
+	auto advantages = fh->getTacticalAdvantage(visitor, armies); //our army is only evaluated once
+	auto advantage = advantages.cbegin();
+	for (auto & guard : guards) //we are interested in strongest army around
+		vstd::amax (guardDanger, guard.second * *advantage++);
+	for (auto & hero : heroes)
+		vstd::amax (guardDanger, hero.second * *advantage++);
 
 
 	//TODO mozna odwiedzic blockvis nie ruszajac straznika
@@ -19,6 +19,7 @@
 #include "../../lib/mapObjects/CGHeroInstance.h"
 
 class CCallback;
+struct CPathsInfo;
 
 typedef const int3& crint3;
 typedef const std::string& crstring;
@@ -111,6 +112,50 @@ struct TimeCheck
 	}
 };
 
+/// Wall clock time given to part of AI turn
+class TimeBudget
+{
+	std::chrono::steady_clock::time_point deadline;
+	bool limited;
+public:
+	TimeBudget(); //without limit
+	explicit TimeBudget(si64 milliseconds); //0 means no limit
+	bool exceeded() const;
+};
+
+/// Armies threatening every tile, computed once per turn for visible guards and enemy heroes
+/// and updated when they appear, move or die so danger of tile doesn't need to be searched again
+class DangerGrid
+{
+public:
+	struct Threat
+	{
+		std::vector<std::pair<const CGObjectInstance *, ui64>> guards; //monsters attacking hero that steps on tile and their strength
+		std::vector<std::pair<const CGHeroInstance *, ui64>> heroes; //enemy heroes that can reach tile till the end of their next turn
+	};
+
+	DangerGrid();
+	~DangerGrid();
+
+	void reset(const std::set<const CGObjectInstance *> & objects);
+	void clear();
+	void addArmy(const CGObjectInstance * obj);
+	void removeArmy(const CGObjectInstance * obj); //can be called just before object is removed from map
+	void removeHero(ObjectInstanceID hero); //hero may be already out of sight
+	void updateTiles(const std::unordered_set<int3, ShashInt3> & tiles); //guards of revealed or hidden tiles
+	const Threat * getThreat(const int3 & tile) const; //nullptr if grid isn't computed
+
+private:
+	int3 sizes;
+	std::vector<Threat> tiles;
+	std::map<ObjectInstanceID, std::pair<const CGHeroInstance *, std::vector<int3>>> heroAreas;
+	std::unique_ptr<CPathsInfo> paths; //reused for all enemy heroes
+
+	ui32 getTileIndex(const int3 & tile) const;
+	void updateGuards(const int3 & tile, const CGObjectInstance * removed = nullptr);
+	void addHero(const CGHeroInstance * hero);
+};
+
 //TODO: replace with vstd::
 struct AtScopeExit
 {
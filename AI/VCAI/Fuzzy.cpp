@@ -17,6 +17,7 @@
 #include "../../lib/CPathfinder.h"
 #include "../../lib/CGameStateFwd.h"
 #include "../../lib/VCMI_Lib.h"
+#include "../../lib/CConfigHandler.h"
 #include "../../CCallback.h"
 #include "VCAI.h"
 
@@ -31,12 +32,17 @@ class CGTownInstance;
 
 //using namespace Goals;
 
-FuzzyHelper *fh;
+boost::thread_specific_ptr<FuzzyHelper> fh;
 
 extern boost::thread_specific_ptr<CCallback> cb;
 extern boost::thread_specific_ptr<VCAI> ai;
 
+const size_t MAX_CACHED_EVALUATIONS = 100000;
+//starting a thread costs about as much as evaluating few goals, so each worker should get more of them
+const size_t MIN_GOALS_PER_THREAD = 8;
+
 engineBase::engineBase()
+	: cache(std::make_shared<EvaluationCache>()), gridSteps(0)
 {
 	engine.addRuleBlock(&rules);
 }
@@ -52,6 +58,65 @@ void engineBase::addRule(const std::string &txt)
 	rules.addRule(fl::Rule::parse(txt, &engine));
 }
 
+fl::scalar engineBase::evaluate(const std::vector<std::pair<fl::InputVariable *, fl::scalar>> & inputs, fl::OutputVariable * output)
+{
+	std::vector<si64> key;
+	key.reserve(inputs.size() * 2);
+	std::vector<fl::scalar> values;
+	values.reserve(inputs.size());
+	bool cacheable = true;
+	for (auto & input : inputs)
+	{
+		fl::scalar value = input.second;
+		si64 index = 0;
+		if (gridSteps > 0)
+		{
+			//engine is evaluated in grid point, so output is same for all inputs rounded to it
+			const fl::scalar minimum = input.first->getMinimum();
+			const fl::scalar step = (input.first->getMaximum() - minimum) / gridSteps;
+			if (std::isfinite(value) && step > 0)
+			{
+				index = std::llround((value - minimum) / step);
+				value = minimum + index * step;
+			}
+			else
+				cacheable = false;
+		}
+		else
+		{
+			//without grid only exactly same inputs share output, so cache doesn't change results
+			static_assert(sizeof(value) <= sizeof(index), "cache key must hold whole input value");
+			std::memcpy(&index, &value, sizeof(value));
+		}
+
+		key.push_back(input.first->isEnabled());
+		key.push_back(index);
+		values.push_back(value);
+	}
+
+	if (cacheable)
+	{
+		boost::shared_lock<boost::shared_mutex> lock(cache->mx);
+		auto it = cache->values.find(key);
+		if (it != cache->values.end())
+			return it->second;
+	}
+
+	for (size_t i = 0; i < inputs.size(); i++)
+		inputs[i].first->setValue(values[i]);
+	engine.process();
+	const fl::scalar result = output->getValue();
+
+	if (cacheable)
+	{
+		boost::unique_lock<boost::shared_mutex> lock(cache->mx);
+		if (cache->values.size() >= MAX_CACHED_EVALUATIONS)
+			cache->values.clear();
+		cache->values[key] = result;
+	}
+	return result;
+}
+
 struct armyStructure
 {
 	float walkers, shooters, flyers;
@@ -94,11 +159,14 @@ armyStructure evaluateArmyStructure (const CArmedInstance * army)
 }
 
 FuzzyHelper::FuzzyHelper()
+	: parallelTime(0), sequentialTime(0), parallelCalls(0), sequentialCalls(0)
 {
 	initTacticalAdvantage();
 	ta.configure();
 	initVisitTile();
 	vt.configure();
+
+	ta.gridSteps = vt.gridSteps = settings["server"]["fuzzyGridSteps"].Float();
 }
 
 
@@ -224,58 +292,60 @@ ui64 FuzzyHelper::estimateBankDanger (const CBank * bank)
 
 float FuzzyHelper::getTacticalAdvantage (const CArmedInstance *we, const CArmedInstance *enemy)
 {
-	float output = 1;
-	try
-	{
-		armyStructure ourStructure = evaluateArmyStructure(we);
-		armyStructure enemyStructure = evaluateArmyStructure(enemy);
-
-		ta.ourWalkers->setValue(ourStructure.walkers);
-		ta.ourShooters->setValue(ourStructure.shooters);
-		ta.ourFlyers->setValue(ourStructure.flyers);
-		ta.ourSpeed->setValue(ourStructure.maxSpeed);
-
-		ta.enemyWalkers->setValue(enemyStructure.walkers);
-		ta.enemyShooters->setValue(enemyStructure.shooters);
-		ta.enemyFlyers->setValue(enemyStructure.flyers);
-		ta.enemySpeed->setValue(enemyStructure.maxSpeed);
-
-		bool bank = dynamic_cast<const CBank*> (enemy);
-		if (bank)
-			ta.bankPresent->setValue(1);
-		else
-			ta.bankPresent->setValue(0);
+	return getTacticalAdvantage(we, std::vector<const CArmedInstance *>(1, enemy)).front();
+}
 
-		const CGTownInstance * fort = dynamic_cast<const CGTownInstance*> (enemy);
-		if (fort)
-		{
-			ta.castleWalls->setValue(fort->fortLevel());
-		}
-		else
-			ta.castleWalls->setValue(0);
+std::vector<float> FuzzyHelper::getTacticalAdvantage (const CArmedInstance *we, const std::vector<const CArmedInstance *> & enemies)
+{
+	std::vector<float> ret;
+	ret.reserve(enemies.size());
 
-		//engine.process(TACTICAL_ADVANTAGE);//TODO: Process only Tactical_Advantage
-		ta.engine.process();
-		output = ta.threat->getValue();
-	}
-	catch (fl::Exception & fe)
+	armyStructure ourStructure = evaluateArmyStructure(we);
+	for (auto enemy : enemies)
 	{
-		logAi->error("getTacticalAdvantage: %s ",fe.getWhat());
-	}
+		float output = 1;
+		try
+		{
+			armyStructure enemyStructure = evaluateArmyStructure(enemy);
+
+			bool bank = dynamic_cast<const CBank*> (enemy);
+			const CGTownInstance * fort = dynamic_cast<const CGTownInstance*> (enemy);
+
+			//engine.process(TACTICAL_ADVANTAGE);//TODO: Process only Tactical_Advantage
+			output = ta.evaluate(
+			{
+				{ta.ourWalkers, ourStructure.walkers},
+				{ta.ourShooters, ourStructure.shooters},
+				{ta.ourFlyers, ourStructure.flyers},
+				{ta.ourSpeed, ourStructure.maxSpeed},
+				{ta.enemyWalkers, enemyStructure.walkers},
+				{ta.enemyShooters, enemyStructure.shooters},
+				{ta.enemyFlyers, enemyStructure.flyers},
+				{ta.enemySpeed, enemyStructure.maxSpeed},
+				{ta.bankPresent, bank ? 1 : 0},
+				{ta.castleWalls, fort ? fort->fortLevel() : 0}
+			}, ta.threat);
+		}
+		catch (fl::Exception & fe)
+		{
+			logAi->error("getTacticalAdvantage: %s ",fe.getWhat());
+		}
 
-	if (output < 0 || (output != output))
-	{
-		fl::InputVariable* tab[] = {ta.bankPresent, ta.castleWalls, ta.ourWalkers, ta.ourShooters, ta.ourFlyers, ta.ourSpeed, ta.enemyWalkers, ta.enemyShooters, ta.enemyFlyers, ta.enemySpeed};
-		std::string names[] = {"bankPresent", "castleWalls", "ourWalkers", "ourShooters", "ourFlyers", "ourSpeed", "enemyWalkers", "enemyShooters", "enemyFlyers", "enemySpeed" };
-		std::stringstream log("Warning! Fuzzy engine doesn't cover this set of parameters: ");
-
-		for (int i = 0; i < boost::size(tab); i++)
-			log << names[i] << ": " << tab[i]->getValue() << " ";
-		logAi->error(log.str());
-		assert(false);
+		if (output < 0 || (output != output))
+		{
+			fl::InputVariable* tab[] = {ta.bankPresent, ta.castleWalls, ta.ourWalkers, ta.ourShooters, ta.ourFlyers, ta.ourSpeed, ta.enemyWalkers, ta.enemyShooters, ta.enemyFlyers, ta.enemySpeed};
+			std::string names[] = {"bankPresent", "castleWalls", "ourWalkers", "ourShooters", "ourFlyers", "ourSpeed", "enemyWalkers", "enemyShooters", "enemyFlyers", "enemySpeed" };
+			std::stringstream log("Warning! Fuzzy engine doesn't cover this set of parameters: ");
+
+			for (int i = 0; i < boost::size(tab); i++)
+				log << names[i] << ": " << tab[i]->getValue() << " ";
+			logAi->error(log.str());
+			assert(false);
+		}
+		ret.push_back(output);
 	}
 
-	return output;
+	return ret;
 }
 
 FuzzyHelper::TacticalAdvantage::~TacticalAdvantage()
@@ -301,8 +371,6 @@ Goals::TSubgoal FuzzyHelper::chooseSolution (Goals::TGoalVec vec)
 	if (vec.empty()) //no possibilities found
 		return sptr(Goals::Invalid());
 
-	ai->cachedSectorMaps.clear();
-
 	//a trick to switch between heroes less often - calculatePaths is costly
 	auto sortByHeroes = [](const Goals::TSubgoal & lhs, const Goals::TSubgoal & rhs) -> bool
 	{
@@ -310,10 +378,9 @@ Goals::TSubgoal FuzzyHelper::chooseSolution (Goals::TGoalVec vec)
 	};
 	boost::sort (vec, sortByHeroes);
 
-	for (auto g : vec)
-	{
-		setPriority(g);
-	}
+	//TODO: candidates are still found (getAllPossibleSubgoals) by thread making turn only,
+	//it queries and caches paths and sector maps through VCAI which isn't safe to share between threads
+	setPriorities(vec);
 
 	auto compareGoals = [](const Goals::TSubgoal & lhs, const Goals::TSubgoal & rhs) -> bool
 	{
@@ -441,8 +508,9 @@ float FuzzyHelper::evaluate (Goals::VisitTile & g)
 	}
 
 	float missionImportance = 0;
-	if (vstd::contains(ai->lockedHeroes, g.hero))
-		missionImportance = ai->lockedHeroes[g.hero]->priority;
+	auto lockedMission = ai->lockedHeroes.find(g.hero); //no operator[], goals may be evaluated by many threads
+	if (lockedMission != ai->lockedHeroes.end())
+		missionImportance = lockedMission->second->priority;
 
 	float strengthRatio = 10.0f; //we are much stronger than enemy
 	ui64 danger = evaluateDanger (g.tile, g.hero.h);
@@ -460,15 +528,15 @@ float FuzzyHelper::evaluate (Goals::VisitTile & g)
 		
 	try
 	{
-		vt.strengthRatio->setValue(strengthRatio);
-		vt.heroStrength->setValue((fl::scalar)g.hero->getTotalStrength() / ai->primaryHero()->getTotalStrength());
-		vt.turnDistance->setValue(turns);
-		vt.missionImportance->setValue(missionImportance);
-		vt.estimatedReward->setValue(tilePriority);
-
-		vt.engine.process();
 		//engine.process(VISIT_TILE); //TODO: Process only Visit_Tile
-		g.priority = vt.value->getValue();
+		g.priority = vt.evaluate(
+		{
+			{vt.strengthRatio, strengthRatio},
+			{vt.heroStrength, (fl::scalar)g.hero->getTotalStrength() / ai->primaryHero()->getTotalStrength()},
+			{vt.turnDistance, turns},
+			{vt.missionImportance, missionImportance},
+			{vt.estimatedReward, tilePriority}
+		}, vt.value);
 	}
 	catch (fl::Exception & fe)
 	{
@@ -549,3 +617,90 @@ void FuzzyHelper::setPriority (Goals::TSubgoal & g)
 {
 	g->setpriority(g->accept(this)); //this enforces returned value is set
 }
+
+void FuzzyHelper::setPriorities (Goals::TGoalVec & vec)
+{
+	//looking for a way may build a boat or update sector map, that has to be done by thread making turn
+	std::vector<Goals::TSubgoal *> independentGoals;
+	for (auto & g : vec)
+	{
+		if (g->goalType == Goals::CLEAR_WAY_TO)
+			setPriority(g);
+		else
+			independentGoals.push_back(&g);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	auto reportTime = [&](si64 & totalTime, int & calls, int threads)
+	{
+		const si64 time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		totalTime += time;
+		calls++;
+		logAi->trace("Evaluated %d goals by %d threads in %d us. Average of %d calls with threads %d us, of %d calls without %d us",
+			independentGoals.size(), threads, time,
+			parallelCalls, parallelCalls ? parallelTime / parallelCalls : 0,
+			sequentialCalls, sequentialCalls ? sequentialTime / sequentialCalls : 0);
+	};
+
+	const int threads = std::min<int>(independentGoals.size() / MIN_GOALS_PER_THREAD, std::max<int>(boost::thread::hardware_concurrency(), 1));
+	if (threads < 2)
+	{
+		for (auto g : independentGoals)
+			setPriority(*g);
+		reportTime(sequentialTime, sequentialCalls, 1);
+		return;
+	}
+
+	while (workers.size() < threads)
+	{
+		workers.push_back(make_unique<FuzzyHelper>());
+		workers.back()->ta.cache = ta.cache;
+		workers.back()->vt.cache = vt.cache;
+	}
+
+	//game state is locked by thread making turn, so workers see the same state
+	//every goal is evaluated on its own, so results don't depend on number of threads
+	VCAI * AI = ai.get();
+	boost::mutex mx;
+	size_t nextGoal = 0;
+	std::exception_ptr error;
+
+	std::vector<Task> tasks;
+	for (int i = 0; i < threads; i++)
+	{
+		FuzzyHelper * worker = workers[i].get();
+		tasks.push_back([&, worker]()
+		{
+			setThreadName("VCAI::setPriorities");
+			SetGlobalState state(AI, worker);
+			while (true)
+			{
+				size_t index;
+				{
+					boost::unique_lock<boost::mutex> lock(mx);
+					if (error || nextGoal >= independentGoals.size())
+						break;
+					index = nextGoal++;
+				}
+
+				try
+				{
+					worker->setPriority(*independentGoals[index]);
+				}
+				catch (...)
+				{
+					boost::unique_lock<boost::mutex> lock(mx);
+					if (!error)
+						error = std::current_exception();
+				}
+			}
+		});
+	}
+
+	CThreadHelper helper(&tasks, threads);
+	helper.run();
+	reportTime(parallelTime, parallelCalls, threads);
+
+	if (error)
+		std::rethrow_exception(error);
+}
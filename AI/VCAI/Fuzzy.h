@@ -22,9 +22,23 @@ public:
 	fl::Engine engine;
 	fl::RuleBlock rules;
 
+	/// Engine outputs for inputs that were already evaluated, keyed by grid point or by exact inputs if there is no grid
+	struct EvaluationCache
+	{
+		boost::shared_mutex mx;
+		std::unordered_map<std::vector<si64>, fl::scalar, boost::hash<std::vector<si64>>> values;
+	};
+	/// Shared with engines of worker helpers, so goals evaluated by any thread hit same cache
+	std::shared_ptr<EvaluationCache> cache;
+	/// If set, inputs are rounded to grid with this many steps over range of each variable
+	/// so engine is only evaluated in grid points. Faster, but output is less accurate
+	int gridSteps;
+
 	engineBase();
 	void configure();
 	void addRule(const std::string &txt);
+	/// Sets inputs and processes engine unless output for same (rounded to grid) inputs is cached
+	fl::scalar evaluate(const std::vector<std::pair<fl::InputVariable *, fl::scalar>> & inputs, fl::OutputVariable * output);
 };
 
 class FuzzyHelper
@@ -55,7 +69,11 @@ class FuzzyHelper
 		~EvalVisitTile();
 	} vt;
 
-	
+	/// Fuzzy engines keep state of evaluation, so each thread evaluating goals in parallel has its own helper
+	std::vector<std::unique_ptr<FuzzyHelper>> workers;
+	/// Total time of setPriorities calls with and without worker threads, reported in trace log
+	si64 parallelTime, sequentialTime;
+	int parallelCalls, sequentialCalls;
 
 public:
 	enum RuleBlocks {BANK_DANGER, TACTICAL_ADVANTAGE, VISIT_TILE};
@@ -78,9 +96,12 @@ public:
 	float evaluate (Goals::Invalid & g);
 	float evaluate (Goals::AbstractGoal & g);
 	void setPriority (Goals::TSubgoal & g);
+	/// Same as setPriority for every goal, goals without side effects are evaluated by worker threads
+	void setPriorities (Goals::TGoalVec & vec);
 
 	ui64 estimateBankDanger (const CBank * bank);
 	float getTacticalAdvantage (const CArmedInstance *we, const CArmedInstance *enemy); //returns factor how many times enemy is stronger than us
+	std::vector<float> getTacticalAdvantage (const CArmedInstance *we, const std::vector<const CArmedInstance *> & enemies); //same for many enemies
 
 	Goals::TSubgoal chooseSolution (Goals::TGoalVec vec);
 	//std::shared_ptr<AbstractGoal> chooseSolution (std::vector<std::shared_ptr<AbstractGoal>> & vec);
@@ -16,7 +16,7 @@
 
 extern boost::thread_specific_ptr<CCallback> cb;
 extern boost::thread_specific_ptr<VCAI> ai;
-extern FuzzyHelper * fh; //TODO: this logic should be moved inside VCAI
+extern boost::thread_specific_ptr<FuzzyHelper> fh; //TODO: this logic should be moved inside VCAI
 
 using namespace Goals;
 
@@ -12,6 +12,7 @@
 #include "Fuzzy.h"
 
 #include "../../lib/UnlockGuard.h"
+#include "../../lib/ScopeGuard.h"
 #include "../../lib/mapObjects/MapObjects.h"
 #include "../../lib/CConfigHandler.h"
 #include "../../lib/CHeroHandler.h"
@@ -22,8 +23,6 @@
 #include "../../lib/serializer/BinarySerializer.h"
 #include "../../lib/serializer/BinaryDeserializer.h"
 
-extern FuzzyHelper *fh;
-
 class CGVisitableOPW;
 
 const double SAFE_ATTACK_CONSTANT = 1.5;
@@ -32,26 +31,27 @@ const int GOLD_RESERVE = 10000; //when buying creatures we want to keep at least
 //one thread may be turn of AI and another will be handling a side effect for AI2
 boost::thread_specific_ptr<CCallback> cb;
 boost::thread_specific_ptr<VCAI> ai;
+extern boost::thread_specific_ptr<FuzzyHelper> fh;
 
 //std::map<int, std::map<int, int> > HeroView::infosCount;
 
-//helper RAII to manage global ai/cb ptrs
-struct SetGlobalState
+SetGlobalState::SetGlobalState(VCAI * AI, FuzzyHelper * FH)
 {
-	SetGlobalState(VCAI * AI)
-	{
-		assert(!ai.get());
-		assert(!cb.get());
+	assert(!ai.get());
+	assert(!cb.get());
+	assert(!fh.get());
 
-		ai.reset(AI);
-		cb.reset(AI->myCb.get());
-	}
-	~SetGlobalState()
-	{
-		ai.release();
-		cb.release();
-	}
-};
+	ai.reset(AI);
+	cb.reset(AI->myCb.get());
+	fh.reset(FH ? FH : AI->fuzzyHelper.get());
+}
+
+SetGlobalState::~SetGlobalState()
+{
+	ai.release();
+	cb.release();
+	fh.release();
+}
 
 
 #define SET_GLOBAL_STATE(ai) SetGlobalState _hlpSetState(ai);
@@ -87,6 +87,9 @@ VCAI::VCAI(void)
 	makingTurn = nullptr;
 	destinationTeleport = ObjectInstanceID();
 	destinationTeleportPos = int3(-1);
+	decisionTimeLimit = 0;
+	decisionRunning = false;
+	fuzzyHelper = make_unique<FuzzyHelper>();
 }
 
 VCAI::~VCAI(void)
@@ -108,10 +111,14 @@ void VCAI::heroMoved(const TryMoveHero & details)
 
 	validateObject(details.id); //enemy hero may have left visible area
 	auto hero = cb->getHero(details.id);
-	cachedSectorMaps.clear();
+	if(!hero)
+		dangerGrid.removeHero(details.id);
+	else if(hero->tempOwner != playerID)
+		dangerGrid.addArmy(hero);
 
 	const int3 from = CGHeroInstance::convertPosition(details.start, false),
 		to = CGHeroInstance::convertPosition(details.end, false);
+	invalidateSectorMaps({from, to});
 	const CGObjectInstance *o1 = vstd::frontOrNull(cb->getVisitableObjs(from)),
 		*o2 = vstd::frontOrNull(cb->getVisitableObjs(to));
 
@@ -295,6 +302,8 @@ void VCAI::tileHidden(const std::unordered_set<int3, ShashInt3> &pos)
 	NET_EVENT_HANDLER;
 
 	validateVisitableObjs();
+	invalidateSectorMaps(pos);
+	dangerGrid.updateTiles(pos);
 	clearPathsInfo();
 }
 
@@ -302,10 +311,15 @@ void VCAI::tileRevealed(const std::unordered_set<int3, ShashInt3> &pos)
 {
 	LOG_TRACE(logAi);
 	NET_EVENT_HANDLER;
+	dangerGrid.updateTiles(pos);
 	for(int3 tile : pos)
 		for(const CGObjectInstance *obj : myCb->getVisitableObjs(tile))
+		{
 			addVisitableObj(obj);
+			dangerGrid.addArmy(obj);
+		}
 
+	invalidateSectorMaps(pos);
 	clearPathsInfo();
 }
 
@@ -396,7 +410,8 @@ void VCAI::newObject(const CGObjectInstance * obj)
 	if(obj->isVisitable())
 		addVisitableObj(obj);
 
-	cachedSectorMaps.clear();
+	invalidateSectorMaps(obj);
+	dangerGrid.addArmy(obj);
 }
 
 void VCAI::objectRemoved(const CGObjectInstance *obj)
@@ -423,7 +438,8 @@ void VCAI::objectRemoved(const CGObjectInstance *obj)
 		}
 	}
 
-	cachedSectorMaps.clear(); //invalidate all paths
+	invalidateSectorMaps(obj); //boat of removed hero is on the same tile
+	dangerGrid.removeArmy(obj);
 
 	//TODO
 	//there are other places where CGObjectinstance ptrs are stored...
@@ -587,9 +603,6 @@ void VCAI::init(std::shared_ptr<CCallback> CB)
 	myCb->waitTillRealize = true;
 	myCb->unlockGsWhenWaiting = true;
 
-	if(!fh)
-		fh = new FuzzyHelper();
-
 	retreiveVisitableObjs();
 }
 
@@ -756,6 +769,12 @@ void VCAI::makeTurn()
 	boost::shared_lock<boost::shared_mutex> gsLock(CGameState::mutex);
 	setThreadName("VCAI::makeTurn");
 
+	turnBudget = TimeBudget(settings["server"]["aiTurnTimeLimit"].Float());
+	decisionTimeLimit = settings["server"]["aiDecisionTimeLimit"].Float();
+	decisionBudget = TimeBudget();
+	decisionRunning = false;
+	phasesOutOfTime.clear();
+
 	switch(cb->getDate(Date::DAY_OF_WEEK))
 	{
 		case 1:
@@ -775,6 +794,7 @@ void VCAI::makeTurn()
 			break;
 	}
 	markHeroAbleToExplore (primaryHero());
+	dangerGrid.reset(visitableObjs);
 
 	makeTurnInternal();
 
@@ -807,6 +827,8 @@ void VCAI::makeTurnInternal()
 			boost::sort (vec, CDistanceSorter(hero.first.get()));
 			for (auto obj : vec)
 			{
+				if(outOfTime("reserved objects"))
+					break;
 				if(!obj || !cb->getObj(obj->id))
 				{
 					logAi->error("Error: there is wrong object on list for hero %s", hero.first->name);
@@ -817,12 +839,13 @@ void VCAI::makeTurnInternal()
 		}
 
 		//now try to win
-		striveToGoal(sptr(Goals::Win()));
+		if(!outOfTime("win"))
+			striveToGoal(sptr(Goals::Win()));
 
 		//finally, continue our abstract long-term goals
 		int oldMovement = 0;
 		int newMovement = 0;
-		while (true)
+		while (!outOfTime("locked goals"))
 		{
 			oldMovement = newMovement; //remember old value
 			newMovement = 0;
@@ -859,10 +882,13 @@ void VCAI::makeTurnInternal()
 		auto quests = myCb->getMyQuests();
 		for (auto quest : quests)
 		{
+			if(outOfTime("quests"))
+				break;
 			striveToQuest (quest);
 		}
 
-		striveToGoal(sptr(Goals::Build())); //TODO: smarter building management
+		if(!outOfTime("build"))
+			striveToGoal(sptr(Goals::Build())); //TODO: smarter building management
 		performTypicalActions();
 
 		//for debug purpose
@@ -1497,8 +1523,13 @@ void VCAI::wander(HeroPtr h)
 	}
 
 	TimeCheck tc("looking for wander destination");
+	const bool nestedDecision = decisionRunning;
+	if(!nestedDecision)
+		decisionBudget = TimeBudget(decisionTimeLimit);
+	decisionRunning = true;
+	auto decisionEnd = vstd::makeScopeGuard([&](){ decisionRunning = nestedDecision; });
 
-	while (h->movement)
+	while (h->movement && !outOfDecisionTime("wandering"))
 	{
 		validateVisitableObjs();
 		std::vector <ObjectIdRef> dests;
@@ -1637,6 +1668,26 @@ void VCAI::wander(HeroPtr h)
 	}
 }
 
+bool VCAI::outOfTime(const std::string & phase)
+{
+	if(!turnBudget.exceeded())
+		return false;
+
+	if(phasesOutOfTime.insert(phase).second)
+		logAi->debug("Player %s ran out of time in %s", playerID.getStr(), phase);
+	return true;
+}
+
+bool VCAI::outOfDecisionTime(const std::string & phase)
+{
+	if(!decisionBudget.exceeded())
+		return outOfTime(phase);
+
+	if(phasesOutOfTime.insert(phase).second)
+		logAi->debug("Player %s ran out of time in %s", playerID.getStr(), phase);
+	return true;
+}
+
 void VCAI::setGoal(HeroPtr h, Goals::TSubgoal goal)
 {
 	if(goal->invalid())
@@ -1747,7 +1798,6 @@ bool VCAI::isAbleToExplore (HeroPtr h)
 void VCAI::clearPathsInfo()
 {
 	heroesUnableToExplore.clear();
-	cachedSectorMaps.clear();
 }
 
 void VCAI::validateVisitableObjs()
@@ -1887,7 +1937,7 @@ bool VCAI::isAccessibleForHero(const int3 & pos, HeroPtr h, bool includeAllies)
 				return false;
 		}
 	}
-	return cb->getPathsInfo(h.get())->getPathInfo(pos)->reachable();
+	return cb->canReach(h.get(), pos);
 }
 
 bool VCAI::moveHeroToTile(int3 dst, HeroPtr h)
@@ -2202,6 +2252,8 @@ void VCAI::tryRealize(Goals::Build & g)
 {
 	for(const CGTownInstance *t : cb->getTownsInfo())
 	{
+		if(outOfDecisionTime("build"))
+			break;
 		logAi->debug("Looking into %s", t->name);
 		buildStructure(t);
 		buildArmyIn(t);
@@ -2291,6 +2343,10 @@ void VCAI::endTurn()
 		logAi->error("Not having turn at the end of turn???");
 	}
 	logAi->debug("Resources at the end of turn: %s", cb->getResourceAmount().toString());
+	if(!phasesOutOfTime.empty())
+		logAi->warn("Player %s ran out of time in: %s", playerID.getStr(), boost::algorithm::join(phasesOutOfTime, ", "));
+
+	dangerGrid.clear(); //armies will move during turns of other players, grid is computed again on our turn
 
 	do
 	{
@@ -2305,6 +2361,13 @@ void VCAI::striveToGoal(Goals::TSubgoal ultimateGoal)
 	if (ultimateGoal->invalid())
 		return;
 
+	//goals striven to while wandering or realizing other goal stay within budget of outer decision
+	const bool nestedDecision = decisionRunning;
+	if(!nestedDecision)
+		decisionBudget = TimeBudget(decisionTimeLimit);
+	decisionRunning = true;
+	auto decisionEnd = vstd::makeScopeGuard([&](){ decisionRunning = nestedDecision; });
+
 	//we are looking for abstract goals
 	auto abstractGoal = striveToGoalInternal (ultimateGoal, false);
 
@@ -2323,13 +2386,15 @@ Goals::TSubgoal VCAI::striveToGoalInternal(Goals::TSubgoal ultimateGoal, bool on
 	const int searchDepth2 = searchDepth-2;
 	Goals::TSubgoal abstractGoal = sptr(Goals::Invalid());
 
-	while(1)
+	while(!outOfDecisionTime("realizing goals"))
 	{
 		Goals::TSubgoal goal = ultimateGoal;
 		logAi->debug("Striving to goal of type %s", ultimateGoal->name());
 		int maxGoals = searchDepth; //preventing deadlock for mutually dependent goals
 		while(!goal->isElementar && maxGoals && (onlyAbstract || !goal->isAbstract))
 		{
+			if(outOfDecisionTime("goal decomposition"))
+				return abstractGoal; //elementar goal wasn't found, realize ones found before
 			logAi->debug("Considering goal %s", goal->name());
 			try
 			{
@@ -2633,6 +2698,8 @@ int3 VCAI::explorationNewPoint(HeroPtr h)
 
 	for (int i = 1; i < radius; i++)
 	{
+		if (outOfDecisionTime("exploration"))
+			break; //go to best tile found so far
 		getVisibleNeighbours(tiles[i-1], tiles[i]);
 		vstd::removeDuplicates(tiles[i]);
 
@@ -2890,7 +2957,10 @@ std::shared_ptr<SectorMap> VCAI::getCachedSectorMap(HeroPtr h)
 {
 	auto it = cachedSectorMaps.find(h);
 	if (it != cachedSectorMaps.end())
+	{
+		it->second->updateChangedTiles();
 		return it->second;
+	}
 	else
 	{
 		cachedSectorMaps[h] = std::make_shared<SectorMap>(h);
@@ -2898,6 +2968,24 @@ std::shared_ptr<SectorMap> VCAI::getCachedSectorMap(HeroPtr h)
 	}
 }
 
+void VCAI::invalidateSectorMaps(const std::unordered_set<int3, ShashInt3> & tiles)
+{
+	//maps are updated once they are needed, hero may reveal tiles and pass objects many times until then
+	for(auto & sm : cachedSectorMaps)
+		sm.second->changedTiles.insert(tiles.begin(), tiles.end());
+}
+
+void VCAI::invalidateSectorMaps(const CGObjectInstance * obj)
+{
+	std::unordered_set<int3, ShashInt3> tiles;
+	for(auto & tile : obj->getBlockedPos())
+		tiles.insert(tile);
+	if(obj->isVisitable())
+		tiles.insert(obj->visitablePos());
+
+	invalidateSectorMaps(tiles);
+}
+
 AIStatus::AIStatus()
 {
 	battle = NO_BATTLE;
@@ -3080,12 +3168,17 @@ bool SectorMap::markIfBlocked(TSectorID &sec, crint3 pos)
 
 void SectorMap::update()
 {
-	visibleTiles = cb->getAllVisibleTiles();
-	auto shape = visibleTiles->shape();
-	sector.resize(boost::extents[shape[0]][shape[1]][shape[2]]);
+	sizes = cb->getMapSize();
+	const ui32 tilesCount = sizes.x * sizes.y * sizes.z;
+	sector.resize(tilesCount);
+	visibleTiles.resize(tilesCount);
+	parent.assign(tilesCount, int3(-1, -1, -1));
+	parentSource = int3(-1, -1, -1);
+	changedTiles.clear();
+	infoOnSectors.clear();
 
 	clear();
-	int curSector = 3; //0 is invisible, 1 is not explored
+	nextSector = 3; //0 is invisible, 1 is not explored
 
 	CCallback * cbp = cb.get(); //optimization
 	foreach_tile_pos([&](crint3 pos)
@@ -3093,38 +3186,87 @@ void SectorMap::update()
 		if(retreiveTile(pos) == NOT_CHECKED)
 		{
 			if(!markIfBlocked(retreiveTile(pos), pos))
-				exploreNewSector(pos, curSector++, cbp);
+				exploreNewSector(pos, nextSector++, cbp);
 		}
 	});
 	valid = true;
 }
 
-SectorMap::TSectorID &SectorMap::retreiveTileN(SectorMap::TSectorArray &a, const int3 &pos)
+void SectorMap::updateChangedTiles()
 {
-	return a[pos.x][pos.y][pos.z];
+	if(changedTiles.empty())
+		return;
+
+	if(!valid)
+	{
+		update();
+		return;
+	}
+
+	CCallback * cbp = cb.get(); //optimization
+
+	//sectors of neighbour tiles may merge with changed tile or lose it as embarkment point
+	std::set<TSectorID> sectorsToExplore;
+	std::vector<int3> tilesToExplore;
+	for(crint3 tile : changedTiles)
+	{
+		tilesToExplore.push_back(tile);
+		sectorsToExplore.insert(retreiveTile(tile));
+		foreach_neighbour(cbp, tile, [&](CCallback * cbp, crint3 neighPos)
+		{
+			sectorsToExplore.insert(retreiveTile(neighPos));
+		});
+	}
+	changedTiles.clear();
+
+	for(TSectorID id : sectorsToExplore)
+	{
+		auto it = infoOnSectors.find(id);
+		if(it != infoOnSectors.end()) //otherwise tile is invisible or blocked
+			range::copy(it->second.tiles, std::back_inserter(tilesToExplore));
+	}
+
+	//each tile may become a new sector, ids are not reused
+	if(nextSector + tilesToExplore.size() >= std::numeric_limits<TSectorID>::max())
+	{
+		update();
+		return;
+	}
+
+	for(TSectorID id : sectorsToExplore)
+		infoOnSectors.erase(id);
+
+	for(crint3 tile : tilesToExplore)
+		resetTile(cbp, tile);
+
+	for(crint3 tile : tilesToExplore)
+	{
+		if(retreiveTile(tile) == NOT_CHECKED && !markIfBlocked(retreiveTile(tile), tile))
+			exploreNewSector(tile, nextSector++, cbp);
+	}
+
+	//objects might have changed the way between tiles
+	parentSource = int3(-1, -1, -1);
+}
+
+ui32 SectorMap::getTileIndex(crint3 pos) const
+{
+	return (pos.z * sizes.y + pos.y) * sizes.x + pos.x;
 }
 
-const SectorMap::TSectorID &SectorMap::retreiveTileN(const SectorMap::TSectorArray &a, const int3 &pos)
+void SectorMap::resetTile(CCallback * cbp, crint3 pos)
 {
-	return a[pos.x][pos.y][pos.z];
+	const ui32 index = getTileIndex(pos);
+	visibleTiles[index] = cbp->getTile(pos, false);
+	sector[index] = visibleTiles[index] ? NOT_CHECKED : NOT_VISIBLE;
 }
 
 void SectorMap::clear()
 {
-	//TODO: rotate to [z][x][y]
-	auto fow = cb->getVisibilityMap();
-	//TODO: any magic to automate this? will need array->array conversion
-	//std::transform(fow.begin(), fow.end(), sector.begin(), [](const ui8 &f) -> unsigned short
-	//{
-	//	return f; //type conversion
-	//});
-	auto width = fow.size();
-	auto height = fow.front().size();
-	auto depth = fow.front().front().size();
-	for (size_t x = 0; x < width; x++)
-		for (size_t y = 0; y < height; y++ )
-			for (size_t z = 0; z < depth; z++)
-				sector[x][y][z] = fow[x][y][z];
+	foreach_tile_pos(cb.get(), [&](CCallback * cbp, crint3 pos)
+	{
+		resetTile(cbp, pos);
+	});
 	valid = false;
 }
 
@@ -3187,7 +3329,7 @@ void SectorMap::write(crstring fname)
 		{
 			for(int i = 0; i < cb->getMapSize().x; i++)
 			{
-				out << (int)sector[i][j][k] << '\t';
+				out << (int)sector[getTileIndex(int3(i, j, k))] << '\t';
 			}
 			out << std::endl;
 		}
@@ -3484,6 +3626,9 @@ int3 SectorMap::findFirstVisitableTile (HeroPtr h, crint3 dst)
 	int3 ret(-1,-1,-1);
 	int3 curtile = dst;
 
+	if(parentSource != h->visitablePos())
+		makeParentBFS(h->visitablePos());
+
 	while(curtile != h->visitablePos())
 	{
 		auto topObj = cb->getTopObj(curtile);
@@ -3499,11 +3644,11 @@ int3 SectorMap::findFirstVisitableTile (HeroPtr h, crint3 dst)
 		}
 		else
 		{
-			auto i = parent.find(curtile);
-			if(i != parent.end())
+			const int3 & next = parent[getTileIndex(curtile)];
+			if(next.valid())
 			{
-				assert(curtile != i->second);
-				curtile = i->second;
+				assert(curtile != next);
+				curtile = next;
 			}
 			else
 			{
@@ -3517,7 +3662,9 @@ int3 SectorMap::findFirstVisitableTile (HeroPtr h, crint3 dst)
 
 void SectorMap::makeParentBFS(crint3 source)
 {
-	parent.clear();
+	std::fill(parent.begin(), parent.end(), int3(-1, -1, -1));
+	parentSource = source;
+	parent[getTileIndex(source)] = source;
 
 	int mySector = retreiveTile(source);
 	std::queue<int3> toVisit;
@@ -3532,12 +3679,13 @@ void SectorMap::makeParentBFS(crint3 source)
 
 		foreach_neighbour(curPos, [&](crint3 neighPos)
 		{
-			if(retreiveTile(neighPos) == mySector && !vstd::contains(parent, neighPos))
+			int3 & neighParent = parent[getTileIndex(neighPos)];
+			if(retreiveTile(neighPos) == mySector && !neighParent.valid())
 			{
 				if (cb->canMoveBetween(curPos, neighPos))
 				{
 					toVisit.push(neighPos);
-					parent[neighPos] = curPos;
+					neighParent = curPos;
 				}
 			}
 		});
@@ -3546,14 +3694,13 @@ void SectorMap::makeParentBFS(crint3 source)
 
 SectorMap::TSectorID & SectorMap::retreiveTile(crint3 pos)
 {
-	return retreiveTileN(sector, pos);
+	return sector[getTileIndex(pos)];
 }
 
-TerrainTile* SectorMap::getTile(crint3 pos) const
+const TerrainTile * SectorMap::getTile(crint3 pos) const
 {
-	//out of bounds access should be handled by boost::multi_array
-	//still we cached this array to avoid any checks
-	return visibleTiles->operator[](pos.x)[pos.y][pos.z];
+	//we cached this array to avoid any checks
+	return visibleTiles[getTileIndex(pos)];
 }
 
 std::vector<const CGObjectInstance *> SectorMap::getNearbyObjs(HeroPtr h, bool sectorsAround)
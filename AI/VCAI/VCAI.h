@@ -26,6 +26,7 @@
 #include "../../lib/CondSh.h"
 
 struct QuestInfo;
+class FuzzyHelper;
 
 class AIStatus
 {
@@ -90,29 +91,34 @@ struct SectorMap
 	};
 
 	typedef unsigned short TSectorID; //smaller than int to allow -1 value. Max number of sectors 65K should be enough for any proper map.
-	typedef boost::multi_array<TSectorID, 3> TSectorArray;
 
 	bool valid; //some kind of lazy eval
-	std::map<int3, int3> parent;
-	TSectorArray sector;
-	//std::vector<std::vector<std::vector<unsigned char>>> pathfinderSector;
+	int3 sizes;
+	int nextSector;
+	//all arrays below are indexed by getTileIndex
+	std::vector<TSectorID> sector;
+	std::vector<const TerrainTile *> visibleTiles; //nullptr if tile is not visible
+	std::vector<int3> parent; //invalid if tile wasn't reached by BFS from parentSource
+	int3 parentSource; //invalid if parents have to be found again
+	std::unordered_set<int3, ShashInt3> changedTiles; //objects or visibility changed since last update
 
 	std::map<int, Sector> infoOnSectors;
-	std::shared_ptr<boost::multi_array<TerrainTile*, 3>> visibleTiles;
 
 	SectorMap();
 	SectorMap(HeroPtr h);
 	void update();
+	/// Explores again only sectors that contain changed tiles or border them
+	void updateChangedTiles();
 	void clear();
 	void exploreNewSector(crint3 pos, int num, CCallback * cbp);
 	void write(crstring fname);
 
 	bool markIfBlocked(TSectorID &sec, crint3 pos, const TerrainTile *t);
 	bool markIfBlocked(TSectorID &sec, crint3 pos);
+	ui32 getTileIndex(crint3 pos) const;
+	void resetTile(CCallback * cbp, crint3 pos);
 	TSectorID & retreiveTile(crint3 pos);
-	TSectorID & retreiveTileN(TSectorArray &vectors, const int3 &pos);
-	const TSectorID & retreiveTileN(const TSectorArray &vectors, const int3 &pos);
-	TerrainTile* getTile(crint3 pos) const;
+	const TerrainTile * getTile(crint3 pos) const;
 	std::vector<const CGObjectInstance *> getNearbyObjs(HeroPtr h, bool sectorsAround);
 
 	void makeParentBFS(crint3 source);
@@ -155,13 +161,21 @@ public:
 	std::set<const CGObjectInstance *> reservedObjs; //to be visited by specific hero
 
 	std::map <HeroPtr, std::shared_ptr<SectorMap>> cachedSectorMaps; //TODO: serialize? not necessary
+	DangerGrid dangerGrid; //computed at the start of turn, not serialized
 
 	TResources saving;
 
+	TimeBudget turnBudget;
+	si64 decisionTimeLimit; //ms for striving to single goal or wandering with single hero, 0 if unlimited
+	TimeBudget decisionBudget;
+	bool decisionRunning; //decisions started during other one don't restart its budget
+	std::set<std::string> phasesOutOfTime; //parts of current turn that were cut short
+
 	AIStatus status;
 	std::string battlename;
 
 	std::shared_ptr<CCallback> myCb;
+	std::unique_ptr<FuzzyHelper> fuzzyHelper;
 
 	std::unique_ptr<boost::thread> makingTurn;
 
@@ -262,6 +276,10 @@ public:
 	Goals::TSubgoal striveToGoalInternal(Goals::TSubgoal ultimateGoal, bool onlyAbstract);
 	void endTurn();
 	void wander(HeroPtr h);
+	/// True if turn ran out of time, in that case phase is recorded
+	bool outOfTime(const std::string & phase);
+	/// Same as outOfTime, but also true if current decision ran out of time. Only for checks inside of decision
+	bool outOfDecisionTime(const std::string & phase);
 	void setGoal(HeroPtr h, Goals::TSubgoal goal);
 	void evaluateGoal(HeroPtr h); //evaluates goal assigned to hero, if any
 	void completeGoal (Goals::TSubgoal goal); //safely removes goal from reserved hero
@@ -309,6 +327,8 @@ public:
 	bool isAccessibleForHero(const int3 & pos, HeroPtr h, bool includeAllies = false) const;
 	//optimization - use one SM for every hero call
 	std::shared_ptr<SectorMap> getCachedSectorMap(HeroPtr h);
+	void invalidateSectorMaps(const std::unordered_set<int3, ShashInt3> & tiles);
+	void invalidateSectorMaps(const CGObjectInstance * obj);
 
 	const CGTownInstance *findTownWithTavern() const;
 	bool canRecruitAnyHero(const CGTownInstance * t = NULL) const;
@@ -371,6 +391,13 @@ public:
 	}
 };
 
+//helper RAII to manage global ai/cb/fh ptrs
+struct SetGlobalState
+{
+	SetGlobalState(VCAI * AI, FuzzyHelper * FH = nullptr); //by default fh of given AI is used
+	~SetGlobalState();
+};
+
 class cannotFulfillGoalException : public std::exception
 {
 	std::string msg;
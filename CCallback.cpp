@@ -290,6 +290,11 @@ const CPathsInfo * CCallback::getPathsInfo(const CGHeroInstance *h)
 	return cl->getPathsInfo(h);
 }
 
+bool CCallback::canReach(const CGHeroInstance *h, const int3 &dst)
+{
+	return cl->canReach(h, dst);
+}
+
 int3 CCallback::getGuardingCreaturePosition(int3 tile)
 {
 	if (!gs->map->isInTheMap(tile))
@@ -105,6 +105,8 @@ public:
 	virtual bool canMoveBetween(const int3 &a, const int3 &b);
 	virtual int3 getGuardingCreaturePosition(int3 tile);
 	virtual const CPathsInfo * getPathsInfo(const CGHeroInstance *h);
+	/// Whether hero can reach tile, searches only for path to it when paths of hero are outdated
+	virtual bool canReach(const CGHeroInstance *h, const int3 &dst);
 
 	virtual void calculatePaths(const CGHeroInstance *hero, CPathsInfo &out);
 
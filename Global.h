@@ -122,7 +122,9 @@ static_assert(sizeof(bool) == 1, "Bool needs to be 1 byte in size.");
 
 #include <algorithm>
 #include <array>
+#include <bitset>
 #include <cassert>
+#include <chrono>
 #include <climits>
 #include <cmath>
 #include <cstdlib>
@@ -732,6 +732,20 @@ void processCommand(const std::string &message)
 			std::cout << "\nBonuses from " << typeid(*parent).name() << std::endl << parent->getBonusList() << std::endl;
 		}
 	}
+	else if(cn == "bonusstats")
+	{
+		std::string what;
+		readed >> what;
+
+		if(what == "on")
+			CBonusSystemStatistics::setEnabled(true);
+		else if(what == "off")
+			CBonusSystemStatistics::setEnabled(false);
+		else if(what == "reset")
+			CBonusSystemStatistics::reset();
+		else
+			CBonusSystemStatistics::print(std::cout);
+	}
 	else if(cn == "not dialog")
 	{
 		LOCPLINT->showingDialog->setn(false);
@@ -946,6 +960,9 @@ void playIntro()
 
 void dispose()
 {
+	if(CBonusSystemStatistics::isEnabled())
+		CBonusSystemStatistics::logReport();
+
 	if(VLC)
 	{
 		delete VLC;
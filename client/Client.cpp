@@ -21,6 +21,7 @@
 #include "../lib/CConsoleHandler.h"
 #include "CGameInfo.h"
 #include "../lib/CGameState.h"
+#include "../lib/CPlayerState.h"
 #include "CPlayerInterface.h"
 #include "../lib/StartInfo.h"
 #include "../lib/battle/BattleInfo.h"
@@ -119,7 +120,8 @@ void CClient::init()
 		TLockGuard _(connectionHandlerMutex);
 		connectionHandler.reset();
 	}
-	pathInfo = nullptr;
+	pathCache.clear();
+	droppedPaths.clear();
 	applier = new CApplier<CBaseForCLApply>();
 	registerTypesClientPacks1(*applier);
 	registerTypesClientPacks2(*applier);
@@ -298,7 +300,8 @@ void CClient::loadGame(const std::string & fname, const bool server, const std::
 		logNetwork->info("Loaded common part of save %d ms", tmh.getDiff());
 		const_cast<CGameInfo*>(CGI)->mh = new CMapHandler();
 		const_cast<CGameInfo*>(CGI)->mh->map = gs->map;
-		pathInfo = make_unique<CPathsInfo>(getMapSize());
+		pathCache.clear();
+		droppedPaths.clear();
 		CGI->mh->init();
 		logNetwork->info("Initing maphandler: %d ms", tmh.getDiff());
 	}
@@ -445,7 +448,8 @@ void CClient::newGame( CConnection *con, StartInfo *si )
 			logNetwork->info("Creating mapHandler: %d ms", tmh.getDiff());
 			CGI->mh->init();
 		}
-		pathInfo = make_unique<CPathsInfo>(getMapSize());
+		pathCache.clear();
+		droppedPaths.clear();
 		logNetwork->info("Initializing mapHandler (together): %d ms", tmh.getDiff());
 	}
 
@@ -865,19 +869,126 @@ void CClient::commenceTacticPhaseForInt(std::shared_ptr<CBattleGameInterface> ba
 void CClient::invalidatePaths()
 {
 	// turn pathfinding info into invalid. It will be regenerated later
-	boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
-	pathInfo->hero = nullptr;
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	for(auto & entry : pathCache)
+	{
+		boost::unique_lock<boost::mutex> pathLock(entry.second->pathMx);
+		entry.second->hero = nullptr;
+	}
+	pathChangedTiles.clear();
+}
+
+void CClient::invalidatePaths(const std::unordered_set<int3, ShashInt3> & changedTiles)
+{
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	for(auto & entry : pathCache)
+	{
+		if(entry.second->hero)
+			pathChangedTiles[entry.first].insert(changedTiles.begin(), changedTiles.end());
+	}
+}
+
+void CClient::invalidatePaths(const CGHeroInstance * h)
+{
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	auto entry = pathCache.find(h);
+	if(entry == pathCache.end())
+		return;
+
+	boost::unique_lock<boost::mutex> pathLock(entry->second->pathMx);
+	entry->second->hero = nullptr;
+	pathChangedTiles.erase(h);
+}
+
+void CClient::dropPaths(const CGHeroInstance * h)
+{
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	auto entry = pathCache.find(h);
+	if(entry == pathCache.end())
+		return;
+
+	droppedPaths.push_back(std::move(entry->second));
+	pathCache.erase(entry);
+	pathChangedTiles.erase(h);
+	singlePathQueries.erase(h);
+}
+
+void CClient::releaseDroppedPaths()
+{
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	droppedPaths.clear();
 }
 
 const CPathsInfo * CClient::getPathsInfo(const CGHeroInstance *h)
 {
 	assert(h);
-	boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
-	if (pathInfo->hero != h)
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+
+	std::map<const CGHeroInstance *, CPathsInfo *> outdated;
+	auto addIfOutdated = [&](const CGHeroInstance * hero)
 	{
-		gs->calculatePaths(h, *pathInfo.get());
+		auto & pathInfo = pathCache[hero];
+		if(!pathInfo)
+			pathInfo = make_unique<CPathsInfo>(getMapSize());
+		if(pathInfo->hero != hero)
+			outdated[hero] = pathInfo.get();
+	};
+
+	addIfOutdated(h);
+	auto changed = pathChangedTiles.find(h);
+	if(outdated.empty() && changed != pathChangedTiles.end())
+	{
+		auto & pathInfo = pathCache[h];
+		boost::unique_lock<boost::mutex> pathLock(pathInfo->pathMx);
+		gs->updatePaths(h, *pathInfo, changed->second);
+		pathChangedTiles.erase(changed);
 	}
-	return pathInfo.get();
+	else if(!outdated.empty())
+	{
+		// AI goes through all its heroes anyway so calculate their paths together
+		// human interface only needs paths of selected hero
+		auto iface = playerint.find(h->tempOwner);
+		const PlayerState * p = gs->getPlayer(h->tempOwner, false);
+		if(p && iface != playerint.end() && !iface->second->human)
+		{
+			for(auto & hero : p->heroes)
+				addIfOutdated(hero);
+		}
+
+		std::vector<boost::unique_lock<boost::mutex>> pathLocks;
+		for(auto & entry : outdated)
+			pathLocks.push_back(boost::unique_lock<boost::mutex>(entry.second->pathMx));
+
+		gs->calculatePaths(outdated);
+		for(auto & entry : outdated)
+		{
+			pathChangedTiles.erase(entry.first);
+			singlePathQueries.erase(entry.first);
+		}
+	}
+	return pathCache[h].get();
+}
+
+bool CClient::canReach(const CGHeroInstance * h, const int3 & dst)
+{
+	// few checks right after hero moved are answered by searching for path to dst only,
+	// if more of them follow paths are calculated for whole map as it's cheaper than many searches
+	const int MAX_SINGLE_PATH_QUERIES = 3;
+
+	boost::unique_lock<boost::mutex> cacheLock(pathCacheMx);
+	auto entry = pathCache.find(h);
+	const bool outdated = entry == pathCache.end() || entry->second->hero != h;
+	if(outdated && singlePathQueries[h]++ < MAX_SINGLE_PATH_QUERIES)
+	{
+		if(!singlePathInfo || singlePathInfo->sizes != getMapSize())
+			singlePathInfo = make_unique<CPathsInfo>(getMapSize());
+
+		boost::unique_lock<boost::mutex> pathLock(singlePathInfo->pathMx);
+		return gs->calculatePath(h, dst, *singlePathInfo);
+	}
+	cacheLock.unlock();
+
+	return getPathsInfo(h)->getPathInfo(dst)->reachable();
 }
 
 int CClient::sendRequest(const CPack *request, PlayerColor player)
@@ -122,8 +122,19 @@ public:
 /// Class which handles client - server logic
 class CClient : public IGameCallback
 {
-	std::unique_ptr<CPathsInfo> pathInfo;
+	/// Paths of every hero queried so far. Entries are kept after invalidation so pointers given to interfaces stay valid
+	std::map<const CGHeroInstance *, std::unique_ptr<CPathsInfo>> pathCache;
+	/// Tiles changed since paths of hero were calculated, such paths are repaired instead of being calculated again
+	std::map<const CGHeroInstance *, std::unordered_set<int3, ShashInt3>> pathChangedTiles;
+	/// Paths of lost heroes, freed on next turn so pointers given out during current one stay valid
+	std::vector<std::unique_ptr<CPathsInfo>> droppedPaths;
+	/// Searches for single tile made for heroes since their paths were last calculated for whole map
+	std::map<const CGHeroInstance *, int> singlePathQueries;
+	std::unique_ptr<CPathsInfo> singlePathInfo; //reused by searches for single tile
+	boost::mutex pathCacheMx;
 public:
+	/// Tiles of object recorded by applyFirstCl of pack changing it, used by applyCl of the same pack once gamestate is updated
+	std::unordered_set<int3, ShashInt3> changedObjectTiles;
 	std::map<PlayerColor,std::shared_ptr<CCallback> > callbacks; //callbacks given to player interfaces
 	std::map<PlayerColor,std::shared_ptr<CBattleCallback> > battleCallbacks; //callbacks given to player interfaces
 	std::vector<std::shared_ptr<IGameEventsReceiver>> privilagedGameEventReceivers; //scripting modules, spectator interfaces
@@ -168,7 +179,12 @@ public:
 	void proposeNextMission(std::shared_ptr<CCampaignState> camp);
 
 	void invalidatePaths();
+	void invalidatePaths(const std::unordered_set<int3, ShashInt3> & changedTiles); //only objects or visibility of given tiles changed
+	void invalidatePaths(const CGHeroInstance *h); //only movement abilities of given hero changed
 	const CPathsInfo * getPathsInfo(const CGHeroInstance *h);
+	bool canReach(const CGHeroInstance *h, const int3 & dst); //uses cached paths or searches for dst only while they are outdated
+	void dropPaths(const CGHeroInstance *h); //hero was lost, its paths won't be queried anymore
+	void releaseDroppedPaths();
 
 	bool terminate;	// tell to terminate
 	std::unique_ptr<boost::thread> connectionHandler; //thread running run() method
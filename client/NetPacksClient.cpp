@@ -111,6 +111,21 @@
 	}																					\
 	BATTLE_INTERFACE_CALL_RECEIVERS(function, __VA_ARGS__)
 
+//tiles which accessibility for pathfinder depends on given object
+static void addObjectTiles(std::unordered_set<int3, ShashInt3> & tiles, const CGObjectInstance * obj)
+{
+	for(auto & tile : obj->getBlockedPos())
+		tiles.insert(tile);
+	tiles.insert(obj->visitablePos());
+}
+
+//artifacts (boots, wings, etc.) may change movement of the hero holding them
+static void invalidateArtifactHolderPaths(CClient * cl, const ArtifactLocation & al)
+{
+	if(auto h = dynamic_cast<const CGHeroInstance *>(al.relatedObj()))
+		cl->invalidatePaths(h);
+}
+
 void SetResources::applyCl(CClient *cl)
 {
 	//todo: inform on actual resource set transfered
@@ -136,6 +151,7 @@ void SetSecSkill::applyCl(CClient *cl)
 		logNetwork->error("Cannot find hero with ID %d", id.getNum());
 		return;
 	}
+	cl->invalidatePaths(h); //pathfinding, logistics and navigation affect movement
 	INTERFACE_CALL_IF_PRESENT(h->tempOwner,heroSecondarySkillChanged,h,which,val);
 }
 
@@ -163,7 +179,7 @@ void SetMana::applyCl(CClient *cl)
 void SetMovePoints::applyCl(CClient *cl)
 {
 	const CGHeroInstance *h = cl->getHero(hid);
-	cl->invalidatePaths();
+	cl->invalidatePaths(h);
 	INTERFACE_CALL_IF_PRESENT(h->tempOwner, heroMovePointsChanged, h);
 }
 
@@ -183,7 +199,7 @@ void FoWChange::applyCl(CClient *cl)
 				i.second->tileHidden(tiles);
 		}
 	}
-	cl->invalidatePaths();
+	cl->invalidatePaths(tiles);
 }
 
 void SetAvailableHeroes::applyCl(CClient *cl)
@@ -227,16 +243,20 @@ void RebalanceStacks::applyCl(CClient *cl)
 
 void PutArtifact::applyCl(CClient *cl)
 {
+	invalidateArtifactHolderPaths(cl, al);
 	INTERFACE_CALL_IF_PRESENT(al.owningPlayer(), artifactPut, al);
 }
 
 void EraseArtifact::applyCl(CClient *cl)
 {
+	invalidateArtifactHolderPaths(cl, al);
 	INTERFACE_CALL_IF_PRESENT(al.owningPlayer(), artifactRemoved, al);
 }
 
 void MoveArtifact::applyCl(CClient *cl)
 {
+	invalidateArtifactHolderPaths(cl, src);
+	invalidateArtifactHolderPaths(cl, dst);
 	INTERFACE_CALL_IF_PRESENT(src.owningPlayer(), artifactMoved, src, dst);
 	if(src.owningPlayer() != dst.owningPlayer())
 		INTERFACE_CALL_IF_PRESENT(dst.owningPlayer(), artifactMoved, src, dst);
@@ -244,11 +264,13 @@ void MoveArtifact::applyCl(CClient *cl)
 
 void AssembledArtifact::applyCl(CClient *cl)
 {
+	invalidateArtifactHolderPaths(cl, al);
 	INTERFACE_CALL_IF_PRESENT(al.owningPlayer(), artifactAssembled, al);
 }
 
 void DisassembledArtifact::applyCl(CClient *cl)
 {
+	invalidateArtifactHolderPaths(cl, al);
 	INTERFACE_CALL_IF_PRESENT(al.owningPlayer(), artifactDisassembled, al);
 }
 
@@ -261,6 +283,7 @@ void HeroVisit::applyCl(CClient *cl)
 void NewTurn::applyCl(CClient *cl)
 {
 	cl->invalidatePaths();
+	cl->releaseDroppedPaths();
 }
 
 
@@ -289,6 +312,8 @@ void ChangeObjPos::applyFirstCl(CClient *cl)
 	CGObjectInstance *obj = GS(cl)->getObjInstance(objid);
 	if(flags & 1 && CGI->mh)
 		CGI->mh->hideObject(obj);
+
+	addObjectTiles(cl->changedObjectTiles, obj);
 }
 void ChangeObjPos::applyCl(CClient *cl)
 {
@@ -296,7 +321,9 @@ void ChangeObjPos::applyCl(CClient *cl)
 	if(flags & 1 && CGI->mh)
 		CGI->mh->printObject(obj);
 
-	cl->invalidatePaths();
+	addObjectTiles(cl->changedObjectTiles, obj);
+	cl->invalidatePaths(cl->changedObjectTiles);
+	cl->changedObjectTiles.clear();
 }
 
 void PlayerEndsGame::applyCl(CClient *cl)
@@ -352,11 +379,21 @@ void RemoveObject::applyFirstCl(CClient *cl)
 		if(GS(cl)->isVisible(o, i->first))
 			i->second->objectRemoved(o);
 	}
+
+	if(o->ID != Obj::HERO)
+		addObjectTiles(cl->changedObjectTiles, o);
+	else
+		cl->dropPaths(dynamic_cast<const CGHeroInstance *>(o));
 }
 
 void RemoveObject::applyCl(CClient *cl)
 {
-	cl->invalidatePaths();
+	//paths of removed hero must be dropped so don't try to repair them
+	if(cl->changedObjectTiles.empty())
+		cl->invalidatePaths();
+	else
+		cl->invalidatePaths(cl->changedObjectTiles);
+	cl->changedObjectTiles.clear();
 }
 
 void TryMoveHero::applyFirstCl(CClient *cl)
@@ -387,7 +424,14 @@ void TryMoveHero::applyFirstCl(CClient *cl)
 void TryMoveHero::applyCl(CClient *cl)
 {
 	const CGHeroInstance *h = cl->getHero(id);
-	cl->invalidatePaths();
+
+	std::unordered_set<int3, ShashInt3> changedTiles = fowRevealed;
+	for(auto & pos : {start, end})
+	{
+		changedTiles.insert(pos);
+		changedTiles.insert(CGHeroInstance::convertPosition(pos, false));
+	}
+	cl->invalidatePaths(changedTiles);
 
 	if(CGI->mh)
 	{
@@ -529,6 +573,26 @@ void InfoWindow::applyCl(CClient *cl)
 
 void SetObjectProperty::applyCl(CClient *cl)
 {
+	switch(what)
+	{
+	case ObjProperty::OWNER:
+	case ObjProperty::BLOCKVIS:
+	case ObjProperty::ID:
+	case ObjProperty::SUBID:
+		{
+			//only passability of the object itself changes
+			std::unordered_set<int3, ShashInt3> tiles;
+			addObjectTiles(tiles, GS(cl)->getObjInstance(id));
+			cl->invalidatePaths(tiles);
+		}
+		break;
+	default:
+		//keymaster visit (see CGKeys::setPropertyDer) changes passability of border gates anywhere on map
+		if(what >= 101 && what <= 100 + PlayerColor::PLAYER_LIMIT_I)
+			cl->invalidatePaths();
+		break;
+	}
+
 	//inform all players that see this object
 	for(auto it = cl->playerint.cbegin(); it != cl->playerint.cend(); ++it)
 	{
@@ -918,9 +982,12 @@ void CenterView::applyCl(CClient *cl)
 
 void NewObject::applyCl(CClient *cl)
 {
-	cl->invalidatePaths();
-
 	const CGObjectInstance *obj = cl->getObj(id);
+
+	std::unordered_set<int3, ShashInt3> changedTiles;
+	addObjectTiles(changedTiles, obj);
+	cl->invalidatePaths(changedTiles);
+
 	if(CGI->mh)
 		CGI->mh->printObject(obj, true);
 
@@ -52,10 +52,12 @@ const TBonusListPtr CHeroWithMaybePickedArtifact::getAllBonuses(const CSelector
 	else
 		bonusesFromPickedUpArtifact = TBonusListPtr(new BonusList());
 
-	for(auto b : *bonusesFromPickedUpArtifact)
-		*heroBonuses -= b;
+	//hero list may be shared with bonus cache of the hero, so it must not be modified
 	for(auto b : *heroBonuses)
-		out->push_back(b);
+	{
+		if(!vstd::contains(*bonusesFromPickedUpArtifact, b))
+			out->push_back(b);
+	}
 	return out;
 }
 
@@ -36,6 +36,8 @@
 #include "serializer/CTypeList.h"
 #include "serializer/CMemorySerializer.h"
 #include "VCMIDirs.h"
+#include "CThreadHelper.h"
+#include "CHierarchicalPathfinder.h"
 
 #ifdef min
 #undef min
@@ -744,6 +746,8 @@ void CGameState::init(StartInfo * si, bool allowSavingRandomMap)
 	buildBonusSystemTree();
 	initVisitingAndGarrisonedHeroes();
 	initFogOfWar();
+	if(scenarioOps->createRandomMap())
+		checkRandomMapConnectivity();
 
 	// Explicitly initialize static variables
 	for(auto & elem : players)
@@ -1174,6 +1178,7 @@ void CGameState::prepareCrossoverHeroes(std::vector<CGameState::CampaignHeroRepl
 
 				cgh->getBonusLocalFirst(sel)->val = cgh->type->heroClass->primarySkillInitial[g];
 			}
+			cgh->nodeHasChanged();
 		}
 	}
 
@@ -1772,6 +1777,32 @@ void CGameState::initMapObjects()
 	map->calculateGuardingGreaturePositions(); //calculate once again when all the guards are placed and initialized
 }
 
+void CGameState::checkRandomMapConnectivity() const
+{
+	//map generator connects zones of all players by land, guarded passages, subterranean gates or monoliths
+	CStopWatch sw;
+	CHierarchicalPathfinder pathfinder(map);
+
+	const CGObjectInstance * first = nullptr;
+	for(auto & elem : players)
+	{
+		const PlayerState & p = elem.second;
+		const CGObjectInstance * start = nullptr;
+		if(!p.towns.empty())
+			start = p.towns.front();
+		else if(!p.heroes.empty())
+			start = p.heroes.front();
+
+		if(!start || elem.first == PlayerColor::NEUTRAL)
+			continue;
+		if(!first)
+			first = start;
+		else if(!pathfinder.isConnected(first->visitablePos(), start->visitablePos()))
+			logGlobal->warn("Random map: %s player can't reach %s player", elem.first.getStr(), first->tempOwner.getStr());
+	}
+	logGlobal->debug("\tConnectivity of random map checked in %i ms", sw.getDiff());
+}
+
 void CGameState::initVisitingAndGarrisonedHeroes()
 {
 	for(auto k=players.begin(); k!=players.end(); ++k)
@@ -1970,6 +2001,64 @@ void CGameState::calculatePaths(const CGHeroInstance *hero, CPathsInfo &out)
 	pathfinder.calculatePaths();
 }
 
+void CGameState::calculatePaths(const std::map<const CGHeroInstance *, CPathsInfo *> & heroPaths)
+{
+	// settings are not thread-safe so options have to be read before workers are started
+	const CPathfinder::PathfinderOptions options;
+
+	boost::mutex errorMx;
+	std::exception_ptr error;
+
+	std::vector<Task> tasks;
+	tasks.reserve(heroPaths.size());
+	for(auto & heroPath : heroPaths)
+	{
+		const CGHeroInstance * hero = heroPath.first;
+		CPathsInfo * out = heroPath.second;
+		tasks.push_back([=, &options, &errorMx, &error]()
+		{
+			try
+			{
+				CPathfinder pathfinder(*out, this, hero, options);
+				pathfinder.calculatePaths();
+			}
+			catch(...)
+			{
+				boost::unique_lock<boost::mutex> lock(errorMx);
+				if(!error)
+					error = std::current_exception();
+			}
+		});
+	}
+
+	const int threads = std::min<int>(tasks.size(), std::max<int>(boost::thread::hardware_concurrency(), 1));
+	if(threads > 1)
+	{
+		CThreadHelper helper(&tasks, threads);
+		helper.run();
+	}
+	else
+	{
+		for(auto & task : tasks)
+			task();
+	}
+
+	if(error)
+		std::rethrow_exception(error);
+}
+
+void CGameState::updatePaths(const CGHeroInstance *hero, CPathsInfo &out, const std::unordered_set<int3, ShashInt3> & changedTiles)
+{
+	CPathfinder pathfinder(out, this, hero);
+	pathfinder.updatePaths(changedTiles);
+}
+
+bool CGameState::calculatePath(const CGHeroInstance *hero, const int3 & dst, CPathsInfo &out)
+{
+	CPathfinder pathfinder(out, this, hero);
+	return pathfinder.calculatePath(dst);
+}
+
 /**
  * Tells if the tile is guarded by a monster as well as the position
  * of the monster that will attack on it.
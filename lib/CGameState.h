@@ -175,6 +175,13 @@ public:
 	PlayerRelations::PlayerRelations getPlayerRelations(PlayerColor color1, PlayerColor color2);
 	bool checkForVisitableDir(const int3 & src, const int3 & dst) const; //check if src tile is visitable from dst tile
 	void calculatePaths(const CGHeroInstance *hero, CPathsInfo &out); //calculates possible paths for hero, by default uses current hero position and movement left; returns pointer to newly allocated CPath or nullptr if path does not exists
+	/// Calculates paths for several heroes at once, pathfinders run concurrently on worker threads
+	/// Game state is only read by pathfinders, caller must make sure it's not modified until this call returns
+	void calculatePaths(const std::map<const CGHeroInstance *, CPathsInfo *> & heroPaths);
+	/// Repairs paths previously calculated for hero after given tiles changed, see CPathfinder::updatePaths
+	void updatePaths(const CGHeroInstance *hero, CPathsInfo &out, const std::unordered_set<int3, ShashInt3> & changedTiles);
+	/// Calculates only best path of hero to dst, see CPathfinder::calculatePath. Path can be read from out afterwards
+	bool calculatePath(const CGHeroInstance *hero, const int3 & dst, CPathsInfo &out);
 	int3 guardingCreaturePosition (int3 pos) const;
 	std::vector<CGObjectInstance*> guardingCreatures (int3 pos) const;
 	void updateRumor();
@@ -274,6 +281,7 @@ private:
 	void initTowns();
 	void initMapObjects();
 	void initVisitingAndGarrisonedHeroes();
+	void checkRandomMapConnectivity() const; //logs players that can't reach each other
 
 	// ----- bonus system handling -----
 
@@ -0,0 +1,421 @@
+/*
+ * CHierarchicalPathfinder.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+#include "CHierarchicalPathfinder.h"
+
+#include "CHeroHandler.h"
+#include "VCMI_Lib.h"
+#include "mapping/CMap.h"
+#include "mapObjects/CGHeroInstance.h"
+#include "mapObjects/MiscObjects.h"
+
+CHierarchicalPathfinder::CHierarchicalPathfinder(const CMap * Map, const int ClusterSize)
+	: map(Map), clusterSize(ClusterSize)
+{
+	clustersCount = int3((map->width + clusterSize - 1) / clusterSize, (map->height + clusterSize - 1) / clusterSize, map->twoLevel ? 2 : 1);
+	clusters.resize(clustersCount.x * clustersCount.y * clustersCount.z);
+
+	findTeleports();
+	for(ui32 i = 0; i < clusters.size(); i++)
+		buildBorders(i);
+	for(ui32 i = 0; i < clusters.size(); i++)
+		buildEntrances(i);
+}
+
+void CHierarchicalPathfinder::updateTiles(const std::unordered_set<int3, ShashInt3> & tiles)
+{
+	/// Tiles on edge of cluster also affect borders owned by neighbour cluster
+	std::set<ui32> changed;
+	for(auto & tile : tiles)
+	{
+		for(int3 dir : int3::getDirs())
+		{
+			if(map->isInTheMap(tile + dir))
+				changed.insert(getClusterIndex(tile + dir));
+		}
+		if(map->isInTheMap(tile))
+			changed.insert(getClusterIndex(tile));
+	}
+
+	auto oldTeleports = teleports;
+	findTeleports();
+	if(oldTeleports != teleports)
+	{
+		std::vector<std::pair<int3, int3>> difference;
+		std::set_symmetric_difference(oldTeleports.begin(), oldTeleports.end(), teleports.begin(), teleports.end(), std::back_inserter(difference));
+		for(auto & teleport : difference)
+		{
+			changed.insert(getClusterIndex(teleport.first));
+			changed.insert(getClusterIndex(teleport.second));
+		}
+	}
+
+	/// Entrances of neighbour clusters depend on borders too
+	std::set<ui32> rebuilt;
+	for(auto index : changed)
+	{
+		buildBorders(index);
+
+		const int3 pos = getClusterPos(index);
+		rebuilt.insert(index);
+		if(pos.x > 0)
+			rebuilt.insert(index - 1);
+		if(pos.x + 1 < clustersCount.x)
+			rebuilt.insert(index + 1);
+		if(pos.y > 0)
+			rebuilt.insert(index - clustersCount.x);
+		if(pos.y + 1 < clustersCount.y)
+			rebuilt.insert(index + clustersCount.x);
+	}
+	for(auto index : rebuilt)
+		buildEntrances(index);
+}
+
+int CHierarchicalPathfinder::getMovementCost(const int3 & src, const int3 & dst) const
+{
+	return search(src, dst, nullptr);
+}
+
+int CHierarchicalPathfinder::getTurnsToReach(const int3 & src, const int3 & dst, const int movementPerTurn, const int movementLeft) const
+{
+	const int cost = getMovementCost(src, dst);
+	if(cost < 0)
+		return -1;
+	if(cost <= movementLeft)
+		return 0;
+
+	return 1 + (cost - movementLeft - 1) / std::max(movementPerTurn, 1);
+}
+
+bool CHierarchicalPathfinder::isConnected(const int3 & src, const int3 & dst) const
+{
+	return getMovementCost(src, dst) >= 0;
+}
+
+std::vector<int3> CHierarchicalPathfinder::getWaypoints(const int3 & src, const int3 & dst) const
+{
+	std::vector<int3> waypoints;
+	if(search(src, dst, &waypoints) < 0)
+		waypoints.clear();
+
+	return waypoints;
+}
+
+int CHierarchicalPathfinder::getStepCost(const TerrainTile & from, const TerrainTile & to, const bool diagonal)
+{
+	int ret = CGHeroInstance::getRoadCost(to, from);
+	if(!ret)
+		ret = VLC->heroh->terrCosts[from.terType];
+
+	if(diagonal)
+		ret *= 1.414213;
+
+	return ret;
+}
+
+bool CHierarchicalPathfinder::isPassable(const int3 & tile) const
+{
+	const TerrainTile & t = map->getTile(tile);
+	return t.terType != ETerrainType::WATER && t.terType != ETerrainType::ROCK && (!t.blocked || t.visitable);
+}
+
+ui32 CHierarchicalPathfinder::getClusterIndex(const int3 & tile) const
+{
+	return (tile.z * clustersCount.y + tile.y / clusterSize) * clustersCount.x + tile.x / clusterSize;
+}
+
+int3 CHierarchicalPathfinder::getClusterPos(const ui32 index) const
+{
+	return int3(index % clustersCount.x, index / clustersCount.x % clustersCount.y, index / (clustersCount.x * clustersCount.y));
+}
+
+int CHierarchicalPathfinder::getEntranceIndex(const Cluster & cluster, const int3 & tile) const
+{
+	auto it = std::lower_bound(cluster.entrances.begin(), cluster.entrances.end(), tile);
+	if(it == cluster.entrances.end() || *it != tile)
+		return -1;
+
+	return std::distance(cluster.entrances.begin(), it);
+}
+
+ui32 CHierarchicalPathfinder::getTileIndex(const int3 & tile) const
+{
+	return (tile.y % clusterSize) * clusterSize + tile.x % clusterSize;
+}
+
+void CHierarchicalPathfinder::findTeleports()
+{
+	teleports.clear();
+	for(auto & channel : map->teleportChannels)
+	{
+		for(auto & entrance : channel.second->entrances)
+		{
+			for(auto & exit : channel.second->exits)
+			{
+				const CGObjectInstance * from = map->objects[entrance.getNum()];
+				const CGObjectInstance * to = map->objects[exit.getNum()];
+				if(from && to && from != to)
+					teleports.push_back(std::make_pair(from->visitablePos(), to->visitablePos()));
+			}
+		}
+	}
+	std::sort(teleports.begin(), teleports.end());
+}
+
+void CHierarchicalPathfinder::buildBorders(const ui32 index)
+{
+	Cluster & cluster = clusters[index];
+	const int3 pos = getClusterPos(index);
+	const int3 origin(pos.x * clusterSize, pos.y * clusterSize, pos.z);
+	const int width = std::min(clusterSize, map->width - origin.x);
+	const int height = std::min(clusterSize, map->height - origin.y);
+
+	/// Each run of tiles passable on both sides of border gets entrance in the middle, long ones on both ends
+	auto addRuns = [&](std::vector<Crossing> & border, const int3 & first, const int3 & step, const int3 & across, const int length)
+	{
+		border.clear();
+		auto addCrossing = [&](const int3 & tile)
+		{
+			const TerrainTile & from = map->getTile(tile);
+			const TerrainTile & to = map->getTile(tile + across);
+			border.push_back({tile, tile + across, getStepCost(from, to, false), getStepCost(to, from, false)});
+		};
+
+		auto at = [&](const int i)
+		{
+			return first + int3(step.x * i, step.y * i, 0);
+		};
+
+		int runStart = -1;
+		for(int i = 0; i <= length; i++)
+		{
+			const int3 tile = at(i);
+			if(i < length && isPassable(tile) && isPassable(tile + across))
+			{
+				if(runStart < 0)
+					runStart = i;
+				continue;
+			}
+			if(runStart < 0)
+				continue;
+
+			const int runLength = i - runStart;
+			if(runLength < 6)
+			{
+				addCrossing(at(runStart + runLength / 2));
+			}
+			else
+			{
+				addCrossing(at(runStart));
+				addCrossing(at(i - 1));
+			}
+			runStart = -1;
+		}
+	};
+
+	if(pos.x + 1 < clustersCount.x)
+		addRuns(cluster.borders[0], origin + int3(width - 1, 0, 0), int3(0, 1, 0), int3(1, 0, 0), height);
+	if(pos.y + 1 < clustersCount.y)
+		addRuns(cluster.borders[1], origin + int3(0, height - 1, 0), int3(1, 0, 0), int3(0, 1, 0), width);
+}
+
+void CHierarchicalPathfinder::buildEntrances(const ui32 index)
+{
+	Cluster & cluster = clusters[index];
+	const int3 pos = getClusterPos(index);
+
+	cluster.entrances.clear();
+	for(auto & border : cluster.borders)
+	{
+		for(auto & crossing : border)
+			cluster.entrances.push_back(crossing.tile);
+	}
+	if(pos.x > 0)
+	{
+		for(auto & crossing : clusters[index - 1].borders[0])
+			cluster.entrances.push_back(crossing.neighbour);
+	}
+	if(pos.y > 0)
+	{
+		for(auto & crossing : clusters[index - clustersCount.x].borders[1])
+			cluster.entrances.push_back(crossing.neighbour);
+	}
+	for(auto & teleport : teleports)
+	{
+		if(getClusterIndex(teleport.first) == index)
+			cluster.entrances.push_back(teleport.first);
+		if(getClusterIndex(teleport.second) == index)
+			cluster.entrances.push_back(teleport.second);
+	}
+	std::sort(cluster.entrances.begin(), cluster.entrances.end());
+	cluster.entrances.erase(std::unique(cluster.entrances.begin(), cluster.entrances.end()), cluster.entrances.end());
+
+	std::vector<int> costs;
+	cluster.costs.resize(cluster.entrances.size());
+	for(size_t i = 0; i < cluster.entrances.size(); i++)
+	{
+		searchCluster(cluster.entrances[i], false, costs);
+		cluster.costs[i].resize(cluster.entrances.size());
+		for(size_t j = 0; j < cluster.entrances.size(); j++)
+			cluster.costs[i][j] = costs[getTileIndex(cluster.entrances[j])];
+	}
+}
+
+void CHierarchicalPathfinder::searchCluster(const int3 & tile, const bool reverse, std::vector<int> & costs) const
+{
+	const int3 pos = getClusterPos(getClusterIndex(tile));
+	const int3 origin(pos.x * clusterSize, pos.y * clusterSize, pos.z);
+	const int3 end(std::min(origin.x + clusterSize, map->width), std::min(origin.y + clusterSize, map->height), pos.z);
+
+	costs.assign(clusterSize * clusterSize, -1);
+	costs[getTileIndex(tile)] = 0;
+
+	typedef std::pair<int, int3> TQueued;
+	std::priority_queue<TQueued, std::vector<TQueued>, std::greater<TQueued>> queue;
+	queue.push(std::make_pair(0, tile));
+	while(!queue.empty())
+	{
+		const TQueued current = queue.top();
+		queue.pop();
+		if(current.first > costs[getTileIndex(current.second)])
+			continue;
+
+		const TerrainTile & currentTile = map->getTile(current.second);
+		for(int3 dir : int3::getDirs())
+		{
+			const int3 next = current.second + dir;
+			if(next.x < origin.x || next.y < origin.y || next.x >= end.x || next.y >= end.y || !isPassable(next))
+				continue;
+
+			const TerrainTile & nextTile = map->getTile(next);
+			const bool diagonal = dir.x && dir.y;
+			const int cost = current.first + (reverse ? getStepCost(nextTile, currentTile, diagonal) : getStepCost(currentTile, nextTile, diagonal));
+			int & known = costs[getTileIndex(next)];
+			if(known < 0 || known > cost)
+			{
+				known = cost;
+				queue.push(std::make_pair(cost, next));
+			}
+		}
+	}
+}
+
+int CHierarchicalPathfinder::search(const int3 & src, const int3 & dst, std::vector<int3> * waypoints) const
+{
+	if(!map->isInTheMap(src) || !map->isInTheMap(dst) || !isPassable(dst))
+		return -1;
+
+	const ui32 srcCluster = getClusterIndex(src);
+	const ui32 dstCluster = getClusterIndex(dst);
+
+	std::vector<int> fromSrc, toDst;
+	searchCluster(src, false, fromSrc);
+	searchCluster(dst, true, toDst);
+
+	int best = srcCluster == dstCluster ? fromSrc[getTileIndex(dst)] : -1;
+	int3 bestEntrance(-1, -1, -1);
+
+	/// Search over entrances, tiles inside of clusters are only visited near start and destination
+	typedef std::pair<int, int3> TQueued;
+	std::priority_queue<TQueued, std::vector<TQueued>, std::greater<TQueued>> queue;
+	std::unordered_map<int3, int, ShashInt3> costs;
+	std::unordered_map<int3, int3, ShashInt3> previous;
+
+	auto relax = [&](const int3 & tile, const int cost, const int3 & from)
+	{
+		auto it = costs.find(tile);
+		if(it != costs.end() && it->second <= cost)
+			return;
+
+		costs[tile] = cost;
+		if(waypoints)
+			previous[tile] = from;
+		queue.push(std::make_pair(cost, tile));
+	};
+
+	for(auto & entrance : clusters[srcCluster].entrances)
+	{
+		const int cost = fromSrc[getTileIndex(entrance)];
+		if(cost >= 0)
+			relax(entrance, cost, int3(-1, -1, -1));
+	}
+
+	while(!queue.empty())
+	{
+		const TQueued current = queue.top();
+		queue.pop();
+		if(current.first > costs[current.second])
+			continue;
+		if(best >= 0 && current.first >= best)
+			break;
+
+		const int3 & tile = current.second;
+		const ui32 index = getClusterIndex(tile);
+		const Cluster & cluster = clusters[index];
+		if(index == dstCluster && toDst[getTileIndex(tile)] >= 0)
+		{
+			const int cost = current.first + toDst[getTileIndex(tile)];
+			if(best < 0 || cost < best)
+			{
+				best = cost;
+				bestEntrance = tile;
+			}
+		}
+
+		const int entrance = getEntranceIndex(cluster, tile);
+		assert(entrance >= 0);
+		for(size_t i = 0; i < cluster.entrances.size(); i++)
+		{
+			if(cluster.costs[entrance][i] > 0) //neither itself nor unreachable
+				relax(cluster.entrances[i], current.first + cluster.costs[entrance][i], tile);
+		}
+
+		const int3 pos = getClusterPos(index);
+		for(auto & border : cluster.borders)
+		{
+			for(auto & crossing : border)
+			{
+				if(crossing.tile == tile)
+					relax(crossing.neighbour, current.first + crossing.cost, tile);
+			}
+		}
+		if(pos.x > 0)
+		{
+			for(auto & crossing : clusters[index - 1].borders[0])
+			{
+				if(crossing.neighbour == tile)
+					relax(crossing.tile, current.first + crossing.backCost, tile);
+			}
+		}
+		if(pos.y > 0)
+		{
+			for(auto & crossing : clusters[index - clustersCount.x].borders[1])
+			{
+				if(crossing.neighbour == tile)
+					relax(crossing.tile, current.first + crossing.backCost, tile);
+			}
+		}
+
+		auto teleport = std::lower_bound(teleports.begin(), teleports.end(), std::make_pair(tile, int3(-1, -1, -1)));
+		for(; teleport != teleports.end() && teleport->first == tile; ++teleport)
+			relax(teleport->second, current.first, tile);
+	}
+
+	if(waypoints && best >= 0)
+	{
+		waypoints->clear();
+		for(int3 tile = bestEntrance; tile.valid(); tile = previous[tile])
+			waypoints->push_back(tile);
+		std::reverse(waypoints->begin(), waypoints->end());
+		waypoints->push_back(dst);
+	}
+
+	return best;
+}
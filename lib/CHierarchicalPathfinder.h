@@ -0,0 +1,83 @@
+/*
+ * CHierarchicalPathfinder.h, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#pragma once
+
+#include "int3.h"
+
+class CMap;
+struct TerrainTile;
+
+/// Approximate distances over land for huge maps without flooding whole map
+///
+/// Map is split into square clusters. Tiles where movement between neighbour clusters is possible
+/// become entrances and cost of movement between entrances of each cluster is precomputed.
+/// Query only searches tiles of clusters with start and destination, rest is searched over entrances.
+///
+/// Costs are hero-independent: terrain and roads are taken into account, but not hero bonuses,
+/// native terrain, guards or sailing. Tiles with visitable objects are treated as passable.
+/// Two-way and one-way teleports are used as free movement from entrance to exit.
+class DLL_LINKAGE CHierarchicalPathfinder
+{
+public:
+	CHierarchicalPathfinder(const CMap * Map, const int ClusterSize = 16);
+
+	/// Rebuilds clusters that contain given tiles, should be called after objects on these tiles changed
+	void updateTiles(const std::unordered_set<int3, ShashInt3> & tiles);
+
+	/// Approximate movement points needed to get from src to dst, -1 if dst can't be reached
+	int getMovementCost(const int3 & src, const int3 & dst) const;
+	/// Approximate turns needed to reach dst, 0 if it's possible today. -1 if dst can't be reached
+	int getTurnsToReach(const int3 & src, const int3 & dst, const int movementPerTurn, const int movementLeft) const;
+	bool isConnected(const int3 & src, const int3 & dst) const;
+	/// Cluster entrances on the way to dst ending with dst itself
+	/// Exact path to first of them can be found by CPathfinder::calculatePath
+	std::vector<int3> getWaypoints(const int3 & src, const int3 & dst) const;
+
+	static int getStepCost(const TerrainTile & from, const TerrainTile & to, const bool diagonal);
+
+private:
+	struct Crossing
+	{
+		int3 tile; //in cluster that owns border
+		int3 neighbour; //in next cluster to the right or below
+		int cost;
+		int backCost;
+	};
+
+	struct Cluster
+	{
+		std::vector<int3> entrances; //sorted
+		/// [from][to] cost of movement inside of cluster, -1 if there is no way
+		std::vector<std::vector<int>> costs;
+		/// [0] right, [1] bottom border
+		std::vector<Crossing> borders[2];
+	};
+
+	const CMap * map;
+	int clusterSize;
+	int3 clustersCount;
+	std::vector<Cluster> clusters;
+	std::vector<std::pair<int3, int3>> teleports;
+
+	bool isPassable(const int3 & tile) const;
+	ui32 getClusterIndex(const int3 & tile) const;
+	int3 getClusterPos(const ui32 index) const;
+	int getEntranceIndex(const Cluster & cluster, const int3 & tile) const;
+
+	void findTeleports();
+	void buildBorders(const ui32 index);
+	void buildEntrances(const ui32 index);
+
+	/// Costs from tile to every tile of same cluster, or from every tile to tile if reverse is set. Indexed by getTileIndex
+	void searchCluster(const int3 & tile, const bool reverse, std::vector<int> & costs) const;
+	ui32 getTileIndex(const int3 & tile) const; //inside of its cluster
+
+	int search(const int3 & src, const int3 & dst, std::vector<int3> * waypoints) const;
+};
@@ -37,7 +37,12 @@ CPathfinder::PathfinderOptions::PathfinderOptions()
 }
 
 CPathfinder::CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstance * _hero)
-	: CGameInfoCallback(_gs, boost::optional<PlayerColor>()), out(_out), hero(_hero), FoW(getPlayerTeam(hero->tempOwner)->fogOfWarMap), patrolTiles({})
+	: CPathfinder(_out, _gs, _hero, PathfinderOptions())
+{
+}
+
+CPathfinder::CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstance * _hero, const PathfinderOptions & _options)
+	: CGameInfoCallback(_gs, boost::optional<PlayerColor>()), options(_options), out(_out), hero(_hero), FoW(getPlayerTeam(hero->tempOwner)->fogOfWarMap), patrolTiles({}), updating(false), target(-1, -1, -1), minStepCost(0), maxTurnMovement(0)
 {
 	assert(hero);
 	assert(hero == getHero(hero->id));
@@ -47,9 +52,7 @@ CPathfinder::CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstan
     ctObj = dtObj = nullptr;
     destAction = CGPathNode::UNKNOWN;
 
-	out.hero = hero;
-	out.hpos = hero->getPosition(false);
-	if(!isInTheMap(out.hpos)/* || !gs->map->isInTheMap(dest)*/) //check input
+	if(!isInTheMap(hero->getPosition(false))/* || !gs->map->isInTheMap(dest)*/) //check input
 	{
 		logGlobal->error("CGameState::calculatePaths: Hero outside the gs->map? How dare you...");
 		throw std::runtime_error("Wrong checksum");
@@ -58,12 +61,218 @@ CPathfinder::CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstan
 	hlp = make_unique<CPathfinderHelper>(hero, options);
 
 	initializePatrol();
-	initializeGraph();
 	neighbourTiles.reserve(8);
 	neighbours.reserve(16);
 }
 
 void CPathfinder::calculatePaths()
+{
+	out.hero = hero;
+	out.hpos = hero->getPosition(false);
+	out.movement = hero->movement;
+	out.resetNodes();
+
+	//logGlobal->info("Calculating paths for hero %s (adress  %d) of player %d", hero->name, hero , hero->tempOwner);
+
+	//initial tile - set cost on 0 and add to the queue
+	CGPathNode * initialNode = getNode(out.hpos, hero->boat ? ELayer::SAIL : ELayer::LAND);
+	initialNode->turns = 0;
+	initialNode->moveRemains = hero->movement;
+	if(isHeroPatrolLocked())
+		return;
+
+	pushNode(initialNode);
+	processQueue();
+}
+
+bool CPathfinder::calculatePath(const int3 & dst)
+{
+	if(!isInTheMap(dst))
+		return false;
+
+	target = dst;
+	minStepCost = 0;
+	maxTurnMovement = std::max(1, std::max(hlp->getMaxMovePoints(ELayer::LAND), hlp->getMaxMovePoints(ELayer::SAIL)));
+	teleportEntrances.clear();
+
+	/// Movement points gained on embarking break estimate and castle gate leads anywhere
+	if(!options.useCastleGate && !hlp->hasBonusOfType(Bonus::FREE_SHIP_BOARDING))
+	{
+		/// Cheapest step is over cobblestone road, everything else is scaled by favorable winds or bonuses
+		double factor = 0.666;
+		if(hlp->isLayerAvailable(ELayer::AIR))
+			vstd::amin(factor, (100.0 + hlp->getTurnInfo()->valOfBonuses(Bonus::FLYING_MOVEMENT)) / 100.0);
+		if(hlp->isLayerAvailable(ELayer::WATER))
+			vstd::amin(factor, (100.0 + hlp->getTurnInfo()->valOfBonuses(Bonus::WATER_WALKING)) / 100.0);
+		minStepCost = std::max(0, static_cast<int>(50 * factor));
+
+		/// Teleport may bring hero anywhere so estimate is also bounded by distance to nearest entrance
+		for(auto & channel : gs->map->teleportChannels)
+		{
+			for(auto & id : channel.second->entrances)
+			{
+				if(auto obj = getObj(id, false))
+					teleportEntrances.push_back(obj->visitablePos());
+			}
+		}
+	}
+
+	calculatePaths();
+	out.hero = nullptr;
+	target = int3(-1, -1, -1);
+	pq.clear();
+
+	const CGPathNode * node = getTargetNode();
+	return node->reachable();
+}
+
+void CPathfinder::updatePaths(const std::unordered_set<int3, ShashInt3> & changedTiles)
+{
+	if(out.hero != hero || out.hpos != hero->getPosition(false) || out.movement != hero->movement)
+	{
+		calculatePaths();
+		return;
+	}
+
+	/// Objects and guards affect accessibility of neighbouring tiles too
+	std::unordered_set<int3, ShashInt3> dirtyTiles;
+	for(auto & tile : changedTiles)
+	{
+		for(int3 dir : int3::getDirs())
+		{
+			if(isInTheMap(tile + dir))
+				dirtyTiles.insert(tile + dir);
+		}
+		if(isInTheMap(tile))
+			dirtyTiles.insert(tile);
+	}
+
+	/// Teleport edges depend on state of whole channel so they can't be repaired locally
+	for(auto & tile : dirtyTiles)
+	{
+		for(auto obj : gs->map->getTile(tile).visitableObjects)
+		{
+			if(CGTeleport::isTeleport(obj))
+			{
+				calculatePaths();
+				return;
+			}
+		}
+	}
+
+	enum ENodeState : ui8
+	{
+		UNKNOWN = 0,
+		AFFECTED, //node is dirty or its path goes through dirty node
+		UNAFFECTED,
+		SEEDED
+	};
+	std::vector<ui8> states(out.getNodesCount(), UNKNOWN);
+	auto stateOf = [&](const CGPathNode * node) -> ui8 &
+	{
+		return states[out.getIndex(node)];
+	};
+
+	for(auto & tile : dirtyTiles)
+	{
+		for(ELayer i = ELayer::LAND; i < ELayer::NUM_LAYERS; i.advance(1))
+		{
+			if(out.hasLayer(i))
+				stateOf(out.getNode(tile, i)) = AFFECTED;
+		}
+	}
+
+	std::vector<ui32> chain;
+	for(ui32 index = 0; index < out.getNodesCount(); ++index)
+	{
+		if(states[index] != UNKNOWN || !out.getNode(index))
+			continue;
+
+		chain.clear();
+		ui32 ancestor = index;
+		while(ancestor != CGPathNode::NO_NODE && states[ancestor] == UNKNOWN)
+		{
+			chain.push_back(ancestor);
+			ancestor = out.getNode(ancestor)->theNodeBefore;
+		}
+		ui8 state = UNAFFECTED;
+		if(ancestor != CGPathNode::NO_NODE)
+			state = states[ancestor];
+		for(auto link : chain)
+			states[link] = state;
+	}
+
+	/// Drop paths through dirty nodes but keep accessibility of nodes that weren't changed
+	for(ui32 index = 0; index < out.getNodesCount(); ++index)
+	{
+		CGPathNode * node = out.getNode(index);
+		if(node && states[index] == AFFECTED)
+		{
+			auto accessible = node->accessible;
+			node->reset();
+			node->accessible = accessible;
+		}
+	}
+	/// Accessibility of dirty nodes is evaluated again on first access
+	for(auto & tile : dirtyTiles)
+	{
+		for(ELayer i = ELayer::LAND; i < ELayer::NUM_LAYERS; i.advance(1))
+		{
+			if(out.hasLayer(i))
+				out.getNode(tile, i)->reset();
+		}
+	}
+
+	CGPathNode * initialNode = getNode(out.hpos, hero->boat ? ELayer::SAIL : ELayer::LAND);
+	initialNode->turns = 0;
+	initialNode->moveRemains = hero->movement;
+	if(isHeroPatrolLocked())
+		return;
+
+	pq.push(initialNode);
+
+	/// Re-expand nodes which paths are still valid and that may lead into affected ones
+	auto addSeed = [&](CGPathNode * node)
+	{
+		if(node->locked && stateOf(node) == UNAFFECTED)
+		{
+			stateOf(node) = SEEDED;
+			pq.push(node);
+		}
+	};
+	for(ui32 index = 0; index < out.getNodesCount(); ++index)
+	{
+		CGPathNode * node = out.getNode(index);
+		if(!node)
+			continue;
+
+		if(states[index] == AFFECTED)
+		{
+			for(int3 dir : int3::getDirs())
+			{
+				int3 tile = node->coord + dir;
+				if(!isInTheMap(tile))
+					continue;
+
+				for(ELayer i = ELayer::LAND; i < ELayer::NUM_LAYERS; i.advance(1))
+				{
+					if(out.hasLayer(i))
+						addSeed(out.getNode(tile, i));
+				}
+			}
+		}
+		else if(node->action == CGPathNode::VISIT || node->action == CGPathNode::TELEPORT_NORMAL)
+		{
+			addSeed(node);
+		}
+	}
+
+	updating = true;
+	processQueue();
+	updating = false;
+}
+
+void CPathfinder::processQueue()
 {
 	auto passOneTurnLimitCheck = [&]() -> bool
 	{
@@ -95,18 +304,11 @@ void CPathfinder::calculatePaths()
 		return false;
 	};
 
-	//logGlobal->info("Calculating paths for hero %s (adress  %d) of player %d", hero->name, hero , hero->tempOwner);
-
-	//initial tile - set cost on 0 and add to the queue
-	CGPathNode * initialNode = out.getNode(out.hpos, hero->boat ? ELayer::SAIL : ELayer::LAND);
-	initialNode->turns = 0;
-	initialNode->moveRemains = hero->movement;
-	if(isHeroPatrolLocked())
-		return;
-
-	pq.push(initialNode);
 	while(!pq.empty())
 	{
+		if(target.valid() && isTargetReached())
+			break;
+
 		cp = pq.top();
 		pq.pop();
 		cp->locked = true;
@@ -141,11 +343,11 @@ void CPathfinder::calculatePaths()
 				if(cp->layer != i && !isLayerTransitionPossible(i))
 					continue;
 
-				dp = out.getNode(neighbour, i);
-				if(dp->locked)
+				if(!isLayerAllowed(dt, i))
 					continue;
 
-				if(dp->accessible == CGPathNode::NOT_SET)
+				dp = getNode(neighbour, i);
+				if(dp->locked && !updating)
 					continue;
 
 				/// Check transition using tile accessability rules
@@ -178,14 +380,14 @@ void CPathfinder::calculatePaths()
 				if(isBetterWay(remains, turnAtNextTile) &&
 					((cp->turns == turnAtNextTile && remains) || passOneTurnLimitCheck()))
 				{
-					assert(dp != cp->theNodeBefore); //two tiles can't point to each other
+					assert(out.getIndex(dp) != cp->theNodeBefore); //two tiles can't point to each other
 					dp->moveRemains = remains;
 					dp->turns = turnAtNextTile;
-					dp->theNodeBefore = cp;
+					dp->theNodeBefore = out.getIndex(cp);
 					dp->action = destAction;
 
 					if(isMovementAfterDestPossible())
-						pq.push(dp);
+						pushNode(dp);
 				}
 			}
 		} //neighbours loop
@@ -194,8 +396,8 @@ void CPathfinder::calculatePaths()
 		addTeleportExits();
 		for(auto & neighbour : neighbours)
 		{
-			dp = out.getNode(neighbour, cp->layer);
-			if(dp->locked)
+			dp = getNode(neighbour, cp->layer);
+			if(dp->locked && !updating)
 				continue;
 			/// TODO: We may consider use invisible exits on FoW border in future
 			/// Useful for AI when at least one tile around exit is visible and passable
@@ -211,15 +413,65 @@ void CPathfinder::calculatePaths()
 
 				dp->moveRemains = movement;
 				dp->turns = turn;
-				dp->theNodeBefore = cp;
+				dp->theNodeBefore = out.getIndex(cp);
 				dp->action = getTeleportDestAction();
 				if(dp->action == CGPathNode::TELEPORT_NORMAL)
-					pq.push(dp);
+					pushNode(dp);
 			}
 		}
 	} //queue loop
 }
 
+void CPathfinder::pushNode(CGPathNode * node)
+{
+	if(!target.valid() || !minStepCost)
+	{
+		pq.push(node);
+		return;
+	}
+
+	/// Assume that rest of the way is as cheap as possible and no movement points are lost on turn end
+	int turns = node->turns;
+	int remains = static_cast<int>(node->moveRemains) - static_cast<int>(estimateSteps(node->coord)) * minStepCost;
+	if(remains < 0)
+	{
+		int extraTurns = (maxTurnMovement - 1 - remains) / maxTurnMovement;
+		turns += extraTurns;
+		remains += extraTurns * maxTurnMovement;
+	}
+	pq.push(node, std::min(turns, 254), remains);
+}
+
+ui32 CPathfinder::estimateSteps(const int3 & tile) const
+{
+	auto distance = [&](const int3 & pos) -> ui32
+	{
+		return std::max(std::abs(tile.x - pos.x), std::abs(tile.y - pos.y));
+	};
+
+	ui32 ret = distance(target);
+	for(auto & entrance : teleportEntrances)
+		vstd::amin(ret, distance(entrance));
+
+	return ret;
+}
+
+const CGPathNode * CPathfinder::getTargetNode() const
+{
+	return static_cast<const CPathsInfo &>(out).getNode(target);
+}
+
+bool CPathfinder::isTargetReached()
+{
+	const CGPathNode * node = getTargetNode();
+	if(!node->reachable())
+		return false;
+
+	/// Queue priorities are not better than real cost of any node so nodes left can't give better path
+	auto priority = pq.topPriority();
+	return node->turns < priority.first || (node->turns == priority.first && node->moveRemains >= priority.second);
+}
+
 void CPathfinder::addNeighbours()
 {
 	neighbours.clear();
@@ -671,45 +923,34 @@ void CPathfinder::initializePatrol()
 	patrolState = state;
 }
 
-void CPathfinder::initializeGraph()
+bool CPathfinder::isLayerAllowed(const TerrainTile * tinfo, const ELayer layer) const
 {
-	auto updateNode = [&](int3 pos, ELayer layer, const TerrainTile * tinfo)
+	switch(tinfo->terType)
 	{
-		auto node = out.getNode(pos, layer);
-		auto accessibility = evaluateAccessibility(pos, tinfo, layer);
-		node->update(pos, layer, accessibility);
-	};
+	case ETerrainType::ROCK:
+		return false;
 
-	int3 pos;
-	for(pos.x=0; pos.x < out.sizes.x; ++pos.x)
+	case ETerrainType::WATER:
+		return layer == ELayer::SAIL
+			|| (layer == ELayer::AIR && options.useFlying)
+			|| (layer == ELayer::WATER && options.useWaterWalking);
+
+	default:
+		return layer == ELayer::LAND
+			|| (layer == ELayer::AIR && options.useFlying);
+	}
+}
+
+CGPathNode * CPathfinder::getNode(const int3 & coord, const ELayer layer)
+{
+	CGPathNode * node = out.getNode(coord, layer);
+	if(node->accessible == CGPathNode::NOT_SET)
 	{
-		for(pos.y=0; pos.y < out.sizes.y; ++pos.y)
-		{
-			for(pos.z=0; pos.z < out.sizes.z; ++pos.z)
-			{
-				const TerrainTile * tinfo = &gs->map->getTile(pos);
-				switch(tinfo->terType)
-				{
-				case ETerrainType::ROCK:
-					break;
-
-				case ETerrainType::WATER:
-					updateNode(pos, ELayer::SAIL, tinfo);
-					if(options.useFlying)
-						updateNode(pos, ELayer::AIR, tinfo);
-					if(options.useWaterWalking)
-						updateNode(pos, ELayer::WATER, tinfo);
-					break;
-
-				default:
-					updateNode(pos, ELayer::LAND, tinfo);
-					if(options.useFlying)
-						updateNode(pos, ELayer::AIR, tinfo);
-					break;
-				}
-			}
-		}
+		const TerrainTile * tinfo = &gs->map->getTile(coord);
+		if(isLayerAllowed(tinfo, layer))
+			node->accessible = evaluateAccessibility(coord, tinfo, layer);
 	}
+	return node;
 }
 
 CGPathNode::EAccessibility CPathfinder::evaluateAccessibility(const int3 & pos, const TerrainTile * tinfo, const ELayer layer) const
@@ -840,6 +1081,32 @@ bool CPathfinder::addTeleportWhirlpool(const CGWhirlpool * obj) const
 	return options.useTeleportWhirlpool && hlp->hasBonusOfType(Bonus::WHIRLPOOL_PROTECTION) && obj;
 }
 
+static int calculateMovementCost(const CGHeroInstance * h, const TerrainTile & src, const TerrainTile & dst, const TurnInfo * ti)
+{
+	/// TODO: by the original game rules hero shouldn't be affected by terrain penalty while flying.
+	/// Also flying movement only has penalty when player moving over blocked tiles.
+	/// So if you only have base flying with 40% penalty you can still ignore terrain penalty while having zero flying penalty.
+	int ret = h->getTileCost(dst, src, ti);
+	/// Unfortunately this can't be implemented yet as server don't know when player flying and when he's not.
+	/// Difference in cost calculation on client and server is much worse than incorrect cost.
+	/// So this one is waiting till server going to use pathfinder rules for path validation.
+
+	if(dst.blocked && ti->hasBonusOfType(Bonus::FLYING_MOVEMENT))
+	{
+		ret *= (100.0 + ti->valOfBonuses(Bonus::FLYING_MOVEMENT)) / 100.0;
+	}
+	else if(dst.terType == ETerrainType::WATER)
+	{
+		if(h->boat && src.hasFavorableWinds() && dst.hasFavorableWinds())
+			ret *= 0.666;
+		else if(!h->boat && ti->hasBonusOfType(Bonus::WATER_WALKING))
+		{
+			ret *= (100.0 + ti->valOfBonuses(Bonus::WATER_WALKING)) / 100.0;
+		}
+	}
+	return ret;
+}
+
 TurnInfo::BonusCache::BonusCache(TBonusListPtr bl)
 {
 	noTerrainPenalty.reserve(ETerrainType::ROCK);
@@ -928,6 +1195,35 @@ int TurnInfo::getMaxMovePoints(const EPathfindingLayer layer) const
 	return layer == EPathfindingLayer::SAIL ? maxMovePointsWater : maxMovePointsLand;
 }
 
+int TurnInfo::getMovementCost(const TerrainTile & src, const TerrainTile & dst) const
+{
+	const int roadTypes = ERoadType::COBBLESTONE_ROAD + 1;
+	if(src.terType < 0 || src.terType >= GameConstants::TERRAIN_TYPES
+		|| src.roadType < 0 || src.roadType >= roadTypes || dst.roadType < 0 || dst.roadType >= roadTypes)
+	{
+		return calculateMovementCost(hero, src, dst, this);
+	}
+
+	int road = ERoadType::NO_ROAD;
+	if(src.roadType != ERoadType::NO_ROAD && dst.roadType != ERoadType::NO_ROAD)
+		road = std::min(src.roadType, dst.roadType);
+
+	int flags = dst.blocked ? 1 : 0;
+	if(dst.terType == ETerrainType::WATER)
+		flags |= 2;
+	if(src.hasFavorableWinds() && dst.hasFavorableWinds())
+		flags |= 4;
+
+	if(movementCosts.empty())
+		movementCosts.resize(GameConstants::TERRAIN_TYPES * roadTypes * 8, -1);
+
+	int & cost = movementCosts[(src.terType * roadTypes + road) * 8 + flags];
+	if(cost == -1)
+		cost = calculateMovementCost(hero, src, dst, this);
+
+	return cost;
+}
+
 CPathfinderHelper::CPathfinderHelper(const CGHeroInstance * Hero, const CPathfinder::PathfinderOptions & Options)
 	: turn(-1), hero(Hero), options(Options)
 {
@@ -1050,27 +1346,7 @@ int CPathfinderHelper::getMovementCost(const CGHeroInstance * h, const int3 & sr
 		dt = h->cb->getTile(dst);
 	}
 
-	/// TODO: by the original game rules hero shouldn't be affected by terrain penalty while flying.
-	/// Also flying movement only has penalty when player moving over blocked tiles.
-	/// So if you only have base flying with 40% penalty you can still ignore terrain penalty while having zero flying penalty.
-	int ret = h->getTileCost(*dt, *ct, ti);
-	/// Unfortunately this can't be implemented yet as server don't know when player flying and when he's not.
-	/// Difference in cost calculation on client and server is much worse than incorrect cost.
-	/// So this one is waiting till server going to use pathfinder rules for path validation.
-
-	if(dt->blocked && ti->hasBonusOfType(Bonus::FLYING_MOVEMENT))
-	{
-		ret *= (100.0 + ti->valOfBonuses(Bonus::FLYING_MOVEMENT)) / 100.0;
-	}
-	else if(dt->terType == ETerrainType::WATER)
-	{
-		if(h->boat && ct->hasFavorableWinds() && dt->hasFavorableWinds())
-			ret *= 0.666;
-		else if(!h->boat && ti->hasBonusOfType(Bonus::WATER_WALKING))
-		{
-			ret *= (100.0 + ti->valOfBonuses(Bonus::WATER_WALKING)) / 100.0;
-		}
-	}
+	int ret = ti->hero == h ? ti->getMovementCost(*ct, *dt) : calculateMovementCost(h, *ct, *dt, ti);
 
 	if(src.x != dst.x && src.y != dst.y) //it's diagonal move
 	{
@@ -1119,8 +1395,10 @@ int CPathfinderHelper::getMovementCost(const CGHeroInstance * h, const int3 & ds
 	return getMovementCost(h, h->visitablePos(), dst, nullptr, nullptr, h->movement);
 }
 
+const ui32 CGPathNode::NO_NODE;
+
 CGPathNode::CGPathNode()
-	: coord(int3(-1, -1, -1)), layer(ELayer::WRONG)
+	: coord(int3(-1, -1, -1)), epoch(0), layer(ELayer::WRONG)
 {
 	reset();
 }
@@ -1131,23 +1409,10 @@ void CGPathNode::reset()
 	accessible = NOT_SET;
 	moveRemains = 0;
 	turns = 255;
-	theNodeBefore = nullptr;
+	theNodeBefore = NO_NODE;
 	action = UNKNOWN;
 }
 
-void CGPathNode::update(const int3 & Coord, const ELayer Layer, const EAccessibility Accessible)
-{
-	if(layer == ELayer::WRONG)
-	{
-		coord = Coord;
-		layer = Layer;
-	}
-	else
-		reset();
-
-	accessible = Accessible;
-}
-
 bool CGPathNode::reachable() const
 {
 	return turns < 255;
@@ -1178,7 +1443,10 @@ CPathsInfo::CPathsInfo(const int3 & Sizes)
 	: sizes(Sizes)
 {
 	hero = nullptr;
-	nodes.resize(boost::extents[sizes.x][sizes.y][sizes.z][ELayer::NUM_LAYERS]);
+	movement = 0;
+	tilesCount = sizes.x * sizes.y * sizes.z;
+	epoch = 1;
+	getNode(int3(0, 0, 0), ELayer::LAND); //land layer is needed by every hero
 }
 
 CPathsInfo::~CPathsInfo()
@@ -1201,13 +1469,13 @@ bool CPathsInfo::getPath(CGPath & out, const int3 & dst) const
 
 	out.nodes.clear();
 	const CGPathNode * curnode = getNode(dst);
-	if(!curnode->theNodeBefore)
+	if(curnode->theNodeBefore == CGPathNode::NO_NODE)
 		return false;
 
 	while(curnode)
 	{
 		const CGPathNode cpn = * curnode;
-		curnode = curnode->theNodeBefore;
+		curnode = cpn.theNodeBefore == CGPathNode::NO_NODE ? nullptr : getNode(cpn.theNodeBefore);
 		out.nodes.push_back(cpn);
 	}
 	return true;
@@ -1226,14 +1494,216 @@ int CPathsInfo::getDistance(const int3 & tile) const
 
 const CGPathNode * CPathsInfo::getNode(const int3 & coord) const
 {
-	auto landNode = &nodes[coord.x][coord.y][coord.z][ELayer::LAND];
-	if(landNode->reachable())
+	auto landNode = getCurrentNode(ELayer::LAND, getTileIndex(coord));
+	if(landNode->reachable() || !hasLayer(ELayer::SAIL))
 		return landNode;
 	else
-		return &nodes[coord.x][coord.y][coord.z][ELayer::SAIL];
+		return getCurrentNode(ELayer::SAIL, getTileIndex(coord));
+}
+
+const CGPathNode * CPathsInfo::getNode(const ui32 index) const
+{
+	if(!hasLayer(ELayer::EEPathfindingLayer(index / tilesCount)))
+		return nullptr;
+
+	return getCurrentNode(ELayer::EEPathfindingLayer(index / tilesCount), index % tilesCount);
+}
+
+void CPathsInfo::resetNodes()
+{
+	if(++epoch == 0)
+	{
+		/// Counter overflowed so stamps left in nodes can't be trusted anymore
+		for(auto & layerNodes : nodes)
+		{
+			for(auto & node : layerNodes)
+				node.epoch = 0;
+		}
+		epoch = 1;
+	}
 }
 
 CGPathNode * CPathsInfo::getNode(const int3 & coord, const ELayer layer)
 {
-	return &nodes[coord.x][coord.y][coord.z][layer];
+	auto & layerNodes = nodes[layer];
+	if(layerNodes.empty())
+	{
+		layerNodes.resize(tilesCount);
+		int3 pos;
+		ui32 tile = 0;
+		for(pos.z = 0; pos.z < sizes.z; ++pos.z)
+		{
+			for(pos.y = 0; pos.y < sizes.y; ++pos.y)
+			{
+				for(pos.x = 0; pos.x < sizes.x; ++pos.x)
+				{
+					layerNodes[tile].coord = pos;
+					layerNodes[tile].layer = layer;
+					layerNodes[tile].epoch = epoch;
+					++tile;
+				}
+			}
+		}
+	}
+	return getCurrentNode(layer, getTileIndex(coord));
+}
+
+CGPathNode * CPathsInfo::getNode(const ui32 index)
+{
+	if(!hasLayer(ELayer::EEPathfindingLayer(index / tilesCount)))
+		return nullptr;
+
+	return getCurrentNode(ELayer::EEPathfindingLayer(index / tilesCount), index % tilesCount);
+}
+
+ui32 CPathsInfo::getIndex(const CGPathNode * node) const
+{
+	return node->layer * tilesCount + (node - nodes[node->layer].data());
+}
+
+ui32 CPathsInfo::getNodesCount() const
+{
+	return ELayer::NUM_LAYERS * tilesCount;
+}
+
+bool CPathsInfo::hasLayer(const ELayer layer) const
+{
+	return !nodes[layer].empty();
+}
+
+ui32 CPathsInfo::getTileIndex(const int3 & coord) const
+{
+	return (coord.z * sizes.y + coord.y) * sizes.x + coord.x;
+}
+
+const CGPathNode * CPathsInfo::getCurrentNode(const ELayer layer, const ui32 tile) const
+{
+	static const CGPathNode unreached;
+	const auto & node = nodes[layer][tile];
+	return node.epoch == epoch ? &node : &unreached;
+}
+
+CGPathNode * CPathsInfo::getCurrentNode(const ELayer layer, const ui32 tile)
+{
+	auto & node = nodes[layer][tile];
+	if(node.epoch != epoch)
+	{
+		node.reset();
+		node.epoch = epoch;
+	}
+	return &node;
+}
+
+CPathNodeQueue::TurnBuckets::TurnBuckets()
+	: best(0), count(0)
+{
+}
+
+CPathNodeQueue::CPathNodeQueue()
+	: currentTurn(0), count(0)
+{
+}
+
+bool CPathNodeQueue::empty() const
+{
+	return count == 0;
+}
+
+size_t CPathNodeQueue::size() const
+{
+	return count;
+}
+
+void CPathNodeQueue::push(CGPathNode * node)
+{
+	push(node, node->turns, node->moveRemains);
+}
+
+void CPathNodeQueue::push(CGPathNode * node, const ui8 turn, const ui32 moveRemains)
+{
+	if(turns.size() <= turn)
+		turns.resize(turn + 1);
+
+	auto & turnBuckets = turns[turn];
+	if(!turnBuckets)
+	{
+		if(freeTurns.empty())
+		{
+			turnBuckets = make_unique<TurnBuckets>();
+		}
+		else
+		{
+			turnBuckets = std::move(freeTurns.back());
+			freeTurns.pop_back();
+		}
+	}
+
+	if(turnBuckets->buckets.size() <= moveRemains)
+		turnBuckets->buckets.resize(moveRemains + 1);
+
+	turnBuckets->buckets[moveRemains].push_back(node);
+	vstd::amax(turnBuckets->best, moveRemains);
+	turnBuckets->count++;
+	count++;
+
+	// only happens when queue is seeded with nodes in arbitrary order
+	vstd::amin(currentTurn, static_cast<ui32>(turn));
+}
+
+CGPathNode * CPathNodeQueue::top()
+{
+	auto & turnBuckets = findTop();
+	return turnBuckets.buckets[turnBuckets.best].back();
+}
+
+std::pair<ui8, ui32> CPathNodeQueue::topPriority()
+{
+	auto & turnBuckets = findTop();
+	return std::make_pair(static_cast<ui8>(currentTurn), turnBuckets.best);
+}
+
+void CPathNodeQueue::pop()
+{
+	auto & turnBuckets = findTop();
+	turnBuckets.buckets[turnBuckets.best].pop_back();
+	turnBuckets.count--;
+	count--;
+}
+
+void CPathNodeQueue::clear()
+{
+	for(auto & turnBuckets : turns)
+	{
+		if(!turnBuckets)
+			continue;
+
+		for(auto & bucket : turnBuckets->buckets)
+			bucket.clear();
+		turnBuckets->best = 0;
+		turnBuckets->count = 0;
+		freeTurns.push_back(std::move(turnBuckets));
+	}
+	turns.clear();
+	currentTurn = 0;
+	count = 0;
+}
+
+CPathNodeQueue::TurnBuckets & CPathNodeQueue::findTop()
+{
+	assert(!empty());
+	while(!turns[currentTurn] || !turns[currentTurn]->count)
+	{
+		if(turns[currentTurn])
+		{
+			turns[currentTurn]->best = 0;
+			freeTurns.push_back(std::move(turns[currentTurn]));
+		}
+		currentTurn++;
+	}
+
+	auto & turnBuckets = *turns[currentTurn];
+	while(turnBuckets.buckets[turnBuckets.best].empty())
+		turnBuckets.best--;
+
+	return turnBuckets;
 }
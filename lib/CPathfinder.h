@@ -14,8 +14,6 @@
 #include "HeroBonus.h"
 #include "int3.h"
 
-#include <boost/heap/priority_queue.hpp>
-
 class CGHeroInstance;
 class CGObjectInstance;
 struct TerrainTile;
@@ -51,9 +49,12 @@ struct DLL_LINKAGE CGPathNode
 		BLOCKED //tile can't be entered nor visited
 	};
 
-	CGPathNode * theNodeBefore;
+	static const ui32 NO_NODE = 0xFFFFFFFF;
+
+	ui32 theNodeBefore; //index of previous node in CPathsInfo or NO_NODE
 	int3 coord; //coordinates
 	ui32 moveRemains; //remaining tiles after hero reaches the tile
+	ui16 epoch; //calculation that used node last time, see CPathsInfo::resetNodes
 	ui8 turns; //how many turns we have to wait before reachng the tile - 0 means current turn
 	ELayer layer;
 	EAccessibility accessible;
@@ -62,7 +63,6 @@ struct DLL_LINKAGE CGPathNode
 
 	CGPathNode();
 	void reset();
-	void update(const int3 & Coord, const ELayer Layer, const EAccessibility Accessible);
 	bool reachable() const;
 };
 
@@ -83,8 +83,8 @@ struct DLL_LINKAGE CPathsInfo
 
 	const CGHeroInstance * hero;
 	int3 hpos;
+	ui32 movement; //hero movement points paths were calculated for
 	int3 sizes;
-	boost::multi_array<CGPathNode, 4> nodes; //[w][h][level][layer]
 
 	CPathsInfo(const int3 & Sizes);
 	~CPathsInfo();
@@ -92,8 +92,67 @@ struct DLL_LINKAGE CPathsInfo
 	bool getPath(CGPath & out, const int3 & dst) const;
 	int getDistance(const int3 & tile) const;
 	const CGPathNode * getNode(const int3 & coord) const;
+	const CGPathNode * getNode(const ui32 index) const;
 
+	/// Starts new calculation. Nodes are not touched, ones left from previous calculation are unreached for readers
+	/// and reset on first access by pathfinder
+	void resetNodes();
+	/// Nodes of layer are only allocated once pathfinder asks for them so most heroes only have land (and sail) layer
 	CGPathNode * getNode(const int3 & coord, const ELayer layer);
+	CGPathNode * getNode(const ui32 index); //nullptr if layer of node isn't allocated
+	ui32 getIndex(const CGPathNode * node) const;
+	ui32 getNodesCount() const;
+	bool hasLayer(const ELayer layer) const;
+
+private:
+	ui32 tilesCount;
+	ui16 epoch;
+	/// [layer][(z * height + y) * width + x]
+	std::vector<CGPathNode> nodes[ELayer::NUM_LAYERS];
+
+	ui32 getTileIndex(const int3 & coord) const;
+	/// Node left from previous calculation is seen as unreached default node, so readers never write
+	const CGPathNode * getCurrentNode(const ELayer layer, const ui32 tile) const;
+	/// Node left from previous calculation is reset for current one
+	CGPathNode * getCurrentNode(const ELayer layer, const ui32 tile);
+};
+
+/// Queue of nodes for pathfinder: nodes with less turns come first, then ones with more movement points left
+/// Movement from node never gives better node than itself so queue is monotone and nodes are simply
+/// kept in buckets indexed by turn and movement points. Push and pop are constant time in amortized sense.
+class DLL_LINKAGE CPathNodeQueue
+{
+public:
+	CPathNodeQueue();
+
+	bool empty() const;
+	size_t size() const;
+	void push(CGPathNode * node);
+	/// Queues node with given priority instead of its own one, used for estimated cost of A* search
+	void push(CGPathNode * node, const ui8 turn, const ui32 moveRemains);
+	CGPathNode * top();
+	/// Turns and movement points top node was queued with
+	std::pair<ui8, ui32> topPriority();
+	void pop();
+	void clear();
+
+private:
+	struct TurnBuckets
+	{
+		std::vector<std::vector<CGPathNode *>> buckets; //[moveRemains]
+		ui32 best; //no nodes above this bucket
+		size_t count;
+
+		TurnBuckets();
+	};
+
+	/// [turns], buckets of finished turns are moved into freeTurns for reuse
+	std::vector<std::unique_ptr<TurnBuckets>> turns;
+	std::vector<std::unique_ptr<TurnBuckets>> freeTurns;
+	ui32 currentTurn; //no nodes before this turn
+	size_t count;
+
+	TurnBuckets & findTop();
 };
 
 class CPathfinder : private CGameInfoCallback
@@ -101,11 +160,20 @@ class CPathfinder : private CGameInfoCallback
 public:
 	friend class CPathfinderHelper;
 
+	struct PathfinderOptions;
+
 	CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstance * _hero);
+	/// Options are read from global settings which are not safe to access from worker threads
+	/// Pathfinders created for batch calculation should use this constructor with options read beforehand
+	CPathfinder(CPathsInfo & _out, CGameState * _gs, const CGHeroInstance * _hero, const PathfinderOptions & _options);
 	void calculatePaths(); //calculates possible paths for hero, uses current hero position and movement left; returns pointer to newly allocated CPath or nullptr if path does not exists
-
-private:
-	typedef EPathfindingLayer ELayer;
+	/// Repairs paths previously calculated into same CPathsInfo after objects or visibility of given tiles changed
+	/// Only nodes which paths go through changed tiles are recalculated. If hero itself moved or changed falls back to calculatePaths
+	void updatePaths(const std::unordered_set<int3, ShashInt3> & changedTiles);
+	/// Calculates only best path to given tile: nodes are expanded by estimated cost of reaching dst and search
+	/// stops as soon as path can't be improved. Movement rules are same as for calculatePaths, but only nodes
+	/// on found path are valid so out isn't marked as calculated for hero. Returns false if dst can't be reached
+	bool calculatePath(const int3 & dst);
 
 	struct PathfinderOptions
 	{
@@ -156,7 +224,12 @@ private:
 		bool originalMovementRules;
 
 		PathfinderOptions();
-	} options;
+	};
+
+private:
+	typedef EPathfindingLayer ELayer;
+
+	PathfinderOptions options;
 
 	CPathsInfo & out;
 	const CGHeroInstance * hero;
@@ -170,19 +243,7 @@ private:
 	} patrolState;
 	std::unordered_set<int3, ShashInt3> patrolTiles;
 
-	struct NodeComparer
-	{
-		bool operator()(const CGPathNode * lhs, const CGPathNode * rhs) const
-		{
-			if(rhs->turns > lhs->turns)
-				return false;
-			else if(rhs->turns == lhs->turns && rhs->moveRemains <= lhs->moveRemains)
-				return false;
-
-			return true;
-		}
-	};
-	boost::heap::priority_queue<CGPathNode *, boost::heap::compare<NodeComparer> > pq;
+	CPathNodeQueue pq;
 
 	std::vector<int3> neighbourTiles;
 	std::vector<int3> neighbours;
@@ -193,6 +254,19 @@ private:
 	const CGObjectInstance * ctObj, * dtObj;
 	CGPathNode::ENodeAction destAction;
 
+	bool updating; //repairing existing paths: locked nodes still may get better route
+
+	int3 target; //destination of calculatePath, invalid when calculating paths for whole map
+	int minStepCost; //lower bound of movement cost between neighbour tiles, 0 if distance can't be estimated
+	ui32 maxTurnMovement; //upper bound of movement points hero may have on turn start
+	std::vector<int3> teleportEntrances;
+
+	void pushNode(CGPathNode * node);
+	ui32 estimateSteps(const int3 & tile) const;
+	const CGPathNode * getTargetNode() const;
+	bool isTargetReached();
+
+	void processQueue();
 	void addNeighbours();
 	void addTeleportExits();
 
@@ -214,7 +288,8 @@ private:
 	bool isDestinationGuardian() const;
 
 	void initializePatrol();
-	void initializeGraph();
+	bool isLayerAllowed(const TerrainTile * tinfo, const ELayer layer) const;
+	CGPathNode * getNode(const int3 & coord, const ELayer layer); //node with accessibility evaluated for current calculation
 
 	CGPathNode::EAccessibility evaluateAccessibility(const int3 & pos, const TerrainTile * tinfo, const ELayer layer) const;
 	bool isVisitableObj(const CGObjectInstance * obj, const ELayer layer) const;
@@ -250,12 +325,17 @@ struct DLL_LINKAGE TurnInfo
 	mutable int maxMovePointsLand;
 	mutable int maxMovePointsWater;
 	int nativeTerrain;
+	/// Cost only depends on terrain of source tile, road, and few flags of destination tile so it's looked up in table
+	/// [source terrain][road][destination flags], filled on first use. -1 if cost isn't known yet
+	mutable std::vector<int> movementCosts;
 
 	TurnInfo(const CGHeroInstance * Hero, const int Turn = 0);
 	bool isLayerAvailable(const EPathfindingLayer layer) const;
 	bool hasBonusOfType(const Bonus::BonusType type, const int subtype = -1) const;
 	int valOfBonuses(const Bonus::BonusType type, const int subtype = -1) const;
 	int getMaxMovePoints(const EPathfindingLayer layer) const;
+	/// Cost of straight move between neighbour tiles without diagonal and last tile adjustments
+	int getMovementCost(const TerrainTile & src, const TerrainTile & dst) const;
 };
 
 class DLL_LINKAGE CPathfinderHelper
@@ -24,14 +24,11 @@ CThreadHelper::CThreadHelper(std::vector<std::function<void()> > *Tasks, int Thr
 }
 void CThreadHelper::run()
 {
+	//thread_group owns created threads and deletes them on destruction
 	boost::thread_group grupa;
-	std::vector<boost::thread *> thr;
 	for(int i=0;i<threads;i++)
-		thr.push_back(grupa.create_thread(std::bind(&CThreadHelper::processTasks,this)));
+		grupa.create_thread(std::bind(&CThreadHelper::processTasks,this));
 	grupa.join_all();
-
-	for(auto thread : thr)
-		delete thread;
 }
 void CThreadHelper::processTasks()
 {
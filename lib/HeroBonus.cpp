@@ -20,6 +20,9 @@
 #include "CStack.h"
 #include "CArtHandler.h"
 
+#include <boost/core/demangle.hpp>
+#include <typeindex>
+
 #define FOREACH_PARENT(pname) 	TNodes lparents; getParents(lparents); for(CBonusSystemNode *pname : lparents)
 #define FOREACH_CPARENT(pname) 	TCNodes lparents; getParents(lparents); for(const CBonusSystemNode *pname : lparents)
 #define FOREACH_RED_CHILD(pname) 	TNodes lchildren; getRedChildren(lchildren); for(CBonusSystemNode *pname : lchildren)
@@ -88,12 +91,14 @@ CBonusProxy::CBonusProxy(const IBonusBearer * Target, CSelector Selector):
 
 TBonusListPtr CBonusProxy::get() const
 {
-	if(CBonusSystemNode::treeChanged != cachedLast || !data)
+	si64 currentVersion = target->getTreeVersion();
+	if(currentVersion != cachedLast || !data)
 	{
 		//TODO: support limiters
-		data = target->getAllBonuses(selector, nullptr);
+		//returned list may be shared with the bearer's cache, so we dedup our own copy
+		data = std::make_shared<BonusList>(*target->getAllBonuses(selector, nullptr));
 		data->eliminateDuplicates();
-		cachedLast = CBonusSystemNode::treeChanged;
+		cachedLast = currentVersion;
 	}
 	return data;
 }
@@ -103,40 +108,283 @@ const BonusList * CBonusProxy::operator->() const
 	return get().get();
 }
 
-int CBonusSystemNode::treeChanged = 1;
+namespace
+{
+	/// Query counters of single thread, so that threads querying bonuses don't wait for each other
+	struct QueryStatistics
+	{
+		ui64 cachedQueries = 0;
+		ui64 cacheHits = 0;
+		ui64 uncachedQueries = 0;
+		std::unordered_map<BonusSelectorKey, ui64, ShashBonusSelectorKey> selectors;
+		std::map<std::string, ui64> cachingStrings;
+		//selectors without key can't be told apart, so they are counted by caching string of query
+		//or by type of selector function (lambda type names where it was written) if there is none
+		std::map<std::string, ui64> adHocCachingStrings;
+		std::unordered_map<std::type_index, ui64> adHocFunctions;
+
+		void add(const QueryStatistics & other)
+		{
+			cachedQueries += other.cachedQueries;
+			cacheHits += other.cacheHits;
+			uncachedQueries += other.uncachedQueries;
+			for(auto & elem : other.selectors)
+				selectors[elem.first] += elem.second;
+			for(auto & elem : other.cachingStrings)
+				cachingStrings[elem.first] += elem.second;
+			for(auto & elem : other.adHocCachingStrings)
+				adHocCachingStrings[elem.first] += elem.second;
+			for(auto & elem : other.adHocFunctions)
+				adHocFunctions[elem.first] += elem.second;
+		}
+	};
+
+	struct ThreadStatistics
+	{
+		boost::mutex mx; //owning thread only competes for it with print and reset
+		QueryStatistics queries;
+
+		ThreadStatistics();
+		~ThreadStatistics(); //called on thread exit, counters are kept in retired ones
+	};
+
+	struct BonusStatisticsData
+	{
+		std::array<std::atomic<ui64>, CBonusSystemNode::GLOBAL_EFFECTS + 1> rebuilds; //by node type
+		std::atomic<ui64> limitingCalls;
+		std::atomic<si64> limitingTime; //in microseconds
+
+		boost::mutex mx; //protects members below
+		std::set<ThreadStatistics *> threads;
+		QueryStatistics retired; //of threads that already finished
+	};
+
+	BonusStatisticsData & statistics()
+	{
+		//never destroyed, threads may still retire their counters during static destruction
+		static BonusStatisticsData * data = new BonusStatisticsData(); //value-initialized, all counters start zeroed
+		return *data;
+	}
+
+	boost::thread_specific_ptr<ThreadStatistics> threadStatistics;
+
+	ThreadStatistics::ThreadStatistics()
+	{
+		auto & data = statistics();
+		boost::mutex::scoped_lock lock(data.mx);
+		data.threads.insert(this);
+	}
+
+	ThreadStatistics::~ThreadStatistics()
+	{
+		auto & data = statistics();
+		boost::mutex::scoped_lock lock(data.mx);
+		data.threads.erase(this);
+		data.retired.add(queries);
+	}
+
+	template<typename Map>
+	std::vector<std::pair<typename Map::key_type, ui64>> mostFrequent(const Map & counts, size_t limit)
+	{
+		std::vector<std::pair<typename Map::key_type, ui64>> ret(counts.begin(), counts.end());
+		std::sort(ret.begin(), ret.end(), [](const std::pair<typename Map::key_type, ui64> & a, const std::pair<typename Map::key_type, ui64> & b)
+		{
+			return a.second > b.second;
+		});
+		if(ret.size() > limit)
+			ret.resize(limit);
+		return ret;
+	}
+
+	std::string selectorKeyToString(const BonusSelectorKey & key)
+	{
+		if(!key.valid)
+			return "<ad-hoc selector>";
+		if(!key.fields)
+			return "<all>";
+
+		static const std::array<std::string, BonusSelectorKey::FIELDS_COUNT> fieldNames =
+		{
+			"type", "subtype", "info", "source", "sourceID", "effectRange"
+		};
+
+		std::string ret;
+		for(int field = 0; field < BonusSelectorKey::FIELDS_COUNT; field++)
+		{
+			if(!key.has(static_cast<BonusSelectorKey::EField>(field)))
+				continue;
+
+			std::string value = boost::lexical_cast<std::string>(key.values[field]);
+			if(field == BonusSelectorKey::TYPE)
+			{
+				for(auto & elem : bonusNameMap)
+					if(elem.second == key.values[field])
+						value = elem.first;
+			}
+			else if(field == BonusSelectorKey::SOURCE)
+			{
+				for(auto & elem : bonusSourceMap)
+					if(elem.second == key.values[field])
+						value = elem.first;
+			}
+
+			if(!ret.empty())
+				ret += " ";
+			ret += fieldNames[field] + "=" + value;
+		}
+		return ret;
+	}
+}
+
+std::atomic<bool> CBonusSystemStatistics::enabled(false);
+
+void CBonusSystemStatistics::setEnabled(bool on)
+{
+	enabled = on;
+}
+
+void CBonusSystemStatistics::reset()
+{
+	auto & data = statistics();
+	for(auto & rebuilds : data.rebuilds)
+		rebuilds = 0;
+	data.limitingCalls = 0;
+	data.limitingTime = 0;
+
+	boost::mutex::scoped_lock lock(data.mx);
+	data.retired = QueryStatistics();
+	for(auto thread : data.threads)
+	{
+		boost::mutex::scoped_lock threadLock(thread->mx);
+		thread->queries = QueryStatistics();
+	}
+}
+
+void CBonusSystemStatistics::print(std::ostream & out)
+{
+	static const std::array<std::string, CBonusSystemNode::GLOBAL_EFFECTS + 1> nodeTypeNames =
+	{
+		"UNKNOWN", "STACK_INSTANCE", "STACK_BATTLE", "SPECIALTY", "ARTIFACT", "CREATURE", "ARTIFACT_INSTANCE", "HERO", "PLAYER", "TEAM",
+		"TOWN_AND_VISITOR", "BATTLE", "COMMANDER", "GLOBAL_EFFECTS"
+	};
+	const size_t topCount = 20;
+
+	auto & data = statistics();
+	const ui64 limitingCalls = data.limitingCalls;
+	const si64 limitingTime = data.limitingTime;
+
+	QueryStatistics queries;
+	{
+		boost::mutex::scoped_lock lock(data.mx);
+		queries.add(data.retired);
+		for(auto thread : data.threads)
+		{
+			boost::mutex::scoped_lock threadLock(thread->mx);
+			queries.add(thread->queries);
+		}
+	}
+
+	out << "Bonus system statistics" << (isEnabled() ? "" : " (collection disabled)") << "\n";
+	out << "Queries: " << queries.cachedQueries << " cached (" << queries.cacheHits << " served from stored results), " << queries.uncachedQueries << " uncached\n";
+
+	out << "Cache rebuilds by node type:\n";
+	for(size_t i = 0; i < data.rebuilds.size(); i++)
+		if(data.rebuilds[i])
+			out << "\t" << nodeTypeNames[i] << ": " << data.rebuilds[i] << "\n";
+
+	out << "Limiting: " << limitingCalls << " calls, " << limitingTime / 1000 << " ms total";
+	if(limitingCalls)
+		out << ", " << limitingTime / limitingCalls << " us on average";
+	out << "\n";
+
+	out << "Most frequent selectors:\n";
+	for(auto & elem : mostFrequent(queries.selectors, topCount))
+		out << "\t" << elem.second << "\t" << selectorKeyToString(elem.first) << "\n";
+
+	std::map<std::string, ui64> adHocSelectors;
+	for(auto & elem : queries.adHocCachingStrings)
+		adHocSelectors["caching string " + elem.first] += elem.second;
+	for(auto & elem : queries.adHocFunctions)
+		adHocSelectors["function " + boost::core::demangle(elem.first.name())] += elem.second;
+	out << "Most frequent ad-hoc selectors:\n";
+	for(auto & elem : mostFrequent(adHocSelectors, topCount))
+		out << "\t" << elem.second << "\t" << elem.first << "\n";
+	out << "Most frequent caching strings:\n";
+	for(auto & elem : mostFrequent(queries.cachingStrings, topCount))
+		out << "\t" << elem.second << "\t" << elem.first << "\n";
+}
+
+void CBonusSystemStatistics::logReport()
+{
+	std::ostringstream report;
+	print(report);
+	logBonus->info(report.str());
+}
+
+void CBonusSystemStatistics::queryMade(bool cached, bool hit, const CSelector & selector, const std::string & cachingStr)
+{
+	if(!threadStatistics.get())
+		threadStatistics.reset(new ThreadStatistics());
+
+	auto & thread = *threadStatistics;
+	boost::mutex::scoped_lock lock(thread.mx);
+	if(cached)
+		thread.queries.cachedQueries++;
+	else
+		thread.queries.uncachedQueries++;
+	if(hit)
+		thread.queries.cacheHits++;
+
+	if(selector.getKey().valid)
+		thread.queries.selectors[selector.getKey()]++;
+	else if(!cachingStr.empty())
+		thread.queries.adHocCachingStrings[cachingStr]++;
+	else
+		thread.queries.adHocFunctions[std::type_index(selector.getFunctionType())]++;
+	if(!cachingStr.empty())
+		thread.queries.cachingStrings[cachingStr]++;
+}
+
+void CBonusSystemStatistics::cacheRebuilt(int nodeType)
+{
+	statistics().rebuilds.at(nodeType)++;
+}
+
+void CBonusSystemStatistics::limitingDone(std::chrono::steady_clock::duration spent)
+{
+	auto & data = statistics();
+	data.limitingCalls++;
+	data.limitingTime += std::chrono::duration_cast<std::chrono::microseconds>(spent).count();
+}
+
+si64 CBonusSystemNode::treeChanged = 1;
 const bool CBonusSystemNode::cachingEnabled = true;
 
-BonusList::BonusList(bool BelongsToTree) : belongsToTree(BelongsToTree)
+BonusList::BonusList()
 {
 
 }
 
-BonusList::BonusList(const BonusList &bonusList)
+BonusList::BonusList(const BonusList &bonusList):
+	bonuses(bonusList.bonuses)
 {
-	bonuses.resize(bonusList.size());
-	std::copy(bonusList.begin(), bonusList.end(), bonuses.begin());
-	belongsToTree = false;
 }
 
-BonusList::BonusList(BonusList&& other):
-	belongsToTree(false)
+BonusList::BonusList(BonusList&& other)
 {
-	std::swap(belongsToTree, other.belongsToTree);
 	std::swap(bonuses, other.bonuses);
 }
 
 BonusList& BonusList::operator=(const BonusList &bonusList)
 {
-	bonuses.resize(bonusList.size());
-	std::copy(bonusList.begin(), bonusList.end(), bonuses.begin());
-	belongsToTree = false;
+	bonuses = bonusList.bonuses;
 	return *this;
 }
 
-void BonusList::changed()
+BonusList& BonusList::operator=(BonusList && other)
 {
-    if(belongsToTree)
-		CBonusSystemNode::treeHasChanged();
+	std::swap(bonuses, other.bonuses);
+	return *this;
 }
 
 int BonusList::totalValue() const
@@ -259,8 +507,7 @@ void BonusList::getBonuses(BonusList & out, const CSelector &selector, const CSe
 
 void BonusList::getAllBonuses(BonusList &out) const
 {
-	for(auto & b : bonuses)
-		out.push_back(b);
+	out.bonuses.insert(out.bonuses.end(), bonuses.begin(), bonuses.end());
 }
 
 int BonusList::valOfBonuses(const CSelector &select) const
@@ -280,20 +527,17 @@ void BonusList::eliminateDuplicates()
 
 void BonusList::push_back(std::shared_ptr<Bonus> x)
 {
-	bonuses.push_back(x);
-	changed();
+	bonuses.push_back(std::move(x));
 }
 
 BonusList::TInternalContainer::iterator BonusList::erase(const int position)
 {
-	changed();
 	return bonuses.erase(bonuses.begin() + position);
 }
 
 void BonusList::clear()
 {
 	bonuses.clear();
-	changed();
 }
 
 std::vector<BonusList*>::size_type BonusList::operator-=(std::shared_ptr<Bonus> const &i)
@@ -302,20 +546,17 @@ std::vector<BonusList*>::size_type BonusList::operator-=(std::shared_ptr<Bonus>
 	if(itr == bonuses.end())
 		return false;
 	bonuses.erase(itr);
-	changed();
 	return true;
 }
 
 void BonusList::resize(BonusList::TInternalContainer::size_type sz, std::shared_ptr<Bonus> c )
 {
 	bonuses.resize(sz, c);
-	changed();
 }
 
 void BonusList::insert(BonusList::TInternalContainer::iterator position, BonusList::TInternalContainer::size_type n, std::shared_ptr<Bonus> const &x)
 {
 	bonuses.insert(position, n, x);
-	changed();
 }
 
 int IBonusBearer::valOfBonuses(Bonus::BonusType type, const CSelector &selector) const
@@ -572,50 +813,117 @@ const TBonusListPtr CBonusSystemNode::getAllBonuses(const CSelector &selector, c
 	bool limitOnUs = (!root || root == this); //caching won't work when we want to limit bonuses against an external node
 	if (CBonusSystemNode::cachingEnabled && limitOnUs)
 	{
-		// Exclusive access for one thread
-		static boost::mutex m;
-		boost::mutex::scoped_lock lock(m);
-
-		// If the bonus system tree changes(state of a single node or the relations to each other) then
+		// If this node or any of its ancestors changed (state of a single node or the relations to each other) then
 		// cache all bonus objects. Selector objects doesn't matter.
-		if (cachedLast != treeChanged)
+		si64 currentVersion = getTreeVersion();
+		auto current = std::atomic_load(&cache);
+		if (!current || current->version != currentVersion)
 		{
-			cachedBonuses.clear();
-			cachedRequests.clear();
-
 			BonusList allBonuses;
 			getAllBonusesRec(allBonuses);
 			allBonuses.eliminateDuplicates();
-			limitBonuses(allBonuses, cachedBonuses);
 
-			cachedLast = treeChanged;
+			auto limited = std::make_shared<BonusList>();
+			limitBonuses(allBonuses, *limited);
+
+			auto fresh = std::make_shared<BonusCache>();
+			fresh->version = currentVersion;
+			fresh->bonuses = limited;
+			auto bonusesByType = std::make_shared<std::vector<BonusList>>();
+			for(auto & b : *limited)
+			{
+				if(static_cast<size_t>(b->type) >= bonusesByType->size())
+					bonusesByType->resize(b->type + 1);
+				(*bonusesByType)[b->type].push_back(b);
+			}
+			fresh->bonusesByType = bonusesByType;
+			fresh->requests = std::make_shared<BonusCache::TRequests>();
+			fresh->keyedRequests = std::make_shared<BonusCache::TKeyedRequests>();
+
+			// Threads that noticed the change at the same time build equal snapshots, any of them may win
+			current = fresh;
+			std::atomic_store(&cache, current);
+
+			if(CBonusSystemStatistics::isEnabled())
+				CBonusSystemStatistics::cacheRebuilt(nodeType);
 		}
 
 		// If a bonus system request comes with a caching string then look up in the map if there are any
 		// pre-calculated bonus results. Limiters can't be cached so they have to be calculated.
 		if (cachingStr != "")
 		{
-			auto it = cachedRequests.find(cachingStr);
-			if(it != cachedRequests.end())
+			auto it = current->requests->find(cachingStr);
+			if(it != current->requests->end())
 			{
+				if(CBonusSystemStatistics::isEnabled())
+					CBonusSystemStatistics::queryMade(true, true, selector, cachingStr);
+
 				//Cached list contains bonuses for our query with applied limiters
 				return it->second;
 			}
 		}
 
+		// Simple field checks are cached automatically by selector key, without any string building.
+		// Limit selectors are not described by keys, so such requests are not cached.
+		const bool cacheByKey = cachingStr == "" && !limit && selector.getKey().valid;
+		if(cacheByKey)
+		{
+			auto it = current->keyedRequests->find(selector.getKey());
+			if(it != current->keyedRequests->end())
+			{
+				if(CBonusSystemStatistics::isEnabled())
+					CBonusSystemStatistics::queryMade(true, true, selector, cachingStr);
+				return it->second;
+			}
+		}
+
+		if(CBonusSystemStatistics::isEnabled())
+			CBonusSystemStatistics::queryMade(true, false, selector, cachingStr);
+
 		//We still don't have the bonuses (didn't returned them from cache)
 		//Perform bonus selection
+		//If selector is limited to a single bonus type, we only need to check bonuses of that type
+		static const BonusList noBonuses;
+		const BonusList * candidates = current->bonuses.get();
+		const si32 requiredType = selector.getRequiredBonusType();
+		if(requiredType >= 0)
+			candidates = static_cast<size_t>(requiredType) < current->bonusesByType->size() ? &(*current->bonusesByType)[requiredType] : &noBonuses;
+
 		auto ret = std::make_shared<BonusList>();
-		cachedBonuses.getBonuses(*ret, selector, limit);
+		candidates->getBonuses(*ret, selector, limit);
 
-		// Save the results in the cache
-		if(cachingStr != "")
-			cachedRequests[cachingStr] = ret;
+		// Save the results in the cache by publishing a copy of the snapshot with our request added.
+		// If another thread replaced the snapshot meanwhile, retry on top of its version unless it's outdated.
+		if(cachingStr != "" || cacheByKey)
+		{
+			while(current->version == currentVersion)
+			{
+				auto updated = std::make_shared<BonusCache>(*current);
+				if(cacheByKey)
+				{
+					auto keyedRequests = std::make_shared<BonusCache::TKeyedRequests>(*current->keyedRequests);
+					keyedRequests->insert(std::make_pair(selector.getKey(), ret));
+					updated->keyedRequests = keyedRequests;
+				}
+				else
+				{
+					auto requests = std::make_shared<BonusCache::TRequests>(*current->requests);
+					requests->insert(std::make_pair(cachingStr, ret));
+					updated->requests = requests;
+				}
+
+				if(std::atomic_compare_exchange_strong(&cache, &current, std::shared_ptr<const BonusCache>(updated)))
+					break;
+			}
+		}
 
 		return ret;
 	}
 	else
 	{
+		if(CBonusSystemStatistics::isEnabled())
+			CBonusSystemStatistics::queryMade(false, false, selector, cachingStr);
+
 		return getAllBonusesWithoutCaching(selector, limit, root);
 	}
 }
@@ -656,7 +964,7 @@ const TBonusListPtr CBonusSystemNode::getAllBonusesWithoutCaching(const CSelecto
 	return ret;
 }
 
-CBonusSystemNode::CBonusSystemNode() : bonuses(true), exportedBonuses(true), nodeType(UNKNOWN), cachedLast(0)
+CBonusSystemNode::CBonusSystemNode() : nodeType(UNKNOWN), nodeChanged(0)
 {
 }
 
@@ -665,7 +973,7 @@ CBonusSystemNode::CBonusSystemNode(CBonusSystemNode && other):
 	exportedBonuses(std::move(other.exportedBonuses)),
 	nodeType(other.nodeType),
 	description(other.description),
-	cachedLast(0)
+	nodeChanged(0)
 {
 	std::swap(parents, other.parents);
 	std::swap(children, other.children);
@@ -685,9 +993,6 @@ CBonusSystemNode::CBonusSystemNode(CBonusSystemNode && other):
 	}
 
 	//cache ignored
-
-	//cachedBonuses
-	//cachedRequests
 }
 
 CBonusSystemNode::~CBonusSystemNode()
@@ -712,7 +1017,7 @@ void CBonusSystemNode::attachTo(CBonusSystemNode *parent)
 		newRedDescendant(parent);
 
 	parent->newChildAttached(this);
-	CBonusSystemNode::treeHasChanged();
+	nodeHasChanged();
 }
 
 void CBonusSystemNode::detachFrom(CBonusSystemNode *parent)
@@ -726,7 +1031,7 @@ void CBonusSystemNode::detachFrom(CBonusSystemNode *parent)
 
 	parents -= parent;
 	parent->childDetached(this);
-	CBonusSystemNode::treeHasChanged();
+	nodeHasChanged();
 }
 
 void CBonusSystemNode::popBonuses(const CSelector &s)
@@ -766,14 +1071,19 @@ void CBonusSystemNode::addNewBonus(const std::shared_ptr<Bonus>& b)
 	assert(!vstd::contains(exportedBonuses, b));
 	exportedBonuses.push_back(b);
 	exportBonus(b);
-	CBonusSystemNode::treeHasChanged();
 }
 
 void CBonusSystemNode::accumulateBonus(const std::shared_ptr<Bonus>& b)
 {
 	auto bonus = exportedBonuses.getFirst(Selector::typeSubtype(b->type, b->subtype)); //only local bonuses are interesting //TODO: what about value type?
 	if(bonus)
+	{
 		bonus->val += b->val;
+		if(bonus->propagator)
+			CBonusSystemNode::treeHasChanged(); //bonus is shared with nodes it was propagated to
+		else
+			nodeHasChanged();
+	}
 	else
 		addNewBonus(std::make_shared<Bonus>(*b)); //duplicate needed, original may get destroyed
 }
@@ -782,10 +1092,14 @@ void CBonusSystemNode::removeBonus(const std::shared_ptr<Bonus>& b)
 {
 	exportedBonuses -= b;
 	if(b->propagator)
+	{
 		unpropagateBonus(b);
+	}
 	else
+	{
 		bonuses -= b;
-	CBonusSystemNode::treeHasChanged();
+		nodeHasChanged();
+	}
 }
 
 bool CBonusSystemNode::actsAsBonusSourceOnly() const
@@ -806,6 +1120,7 @@ void CBonusSystemNode::propagateBonus(std::shared_ptr<Bonus> b)
 	if(b->propagator->shouldBeAttached(this))
 	{
 		bonuses.push_back(b);
+		nodeHasChanged();
 		logBonus->trace("#$# %s #propagated to# %s",  b->Description(), nodeName());
 	}
 
@@ -823,6 +1138,7 @@ void CBonusSystemNode::unpropagateBonus(std::shared_ptr<Bonus> b)
 			logBonus->error("Bonus was duplicated (%s) at %s", b->Description(), nodeName());
 			bonuses -= b;
 		}
+		nodeHasChanged();
 		logBonus->trace("#$# %s #is no longer propagated to# %s",  b->Description(), nodeName());
 	}
 
@@ -947,11 +1263,14 @@ void CBonusSystemNode::getRedDescendants(TNodes &out)
 void CBonusSystemNode::exportBonus(std::shared_ptr<Bonus> b)
 {
 	if(b->propagator)
+	{
 		propagateBonus(b);
+	}
 	else
+	{
 		bonuses.push_back(b);
-
-	CBonusSystemNode::treeHasChanged();
+		nodeHasChanged();
+	}
 }
 
 void CBonusSystemNode::exportBonuses()
@@ -1004,35 +1323,43 @@ void CBonusSystemNode::limitBonuses(const BonusList &allBonuses, BonusList &out)
 {
 	assert(&allBonuses != &out); //todo should it work in-place?
 
+	const bool measure = CBonusSystemStatistics::isEnabled();
+	const auto start = measure ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
 	BonusList undecided = allBonuses,
+		stillUndecided,
 		&accepted = out;
+	accepted.reserve(accepted.size() + undecided.size());
 
 	while(true)
 	{
 		int undecidedCount = undecided.size();
-		for(int i = 0; i < undecided.size(); i++)
+		stillUndecided.clear();
+		//bonuses are moved between lists, not copied, to avoid reference counting on every pass
+		for(auto & b : undecided)
 		{
-			auto b = undecided[i];
-			BonusLimitationContext context = {b, *this, out};
-			int decision = b->limiter ? b->limiter->limit(context) : ILimiter::ACCEPT; //bonuses without limiters will be accepted by default
-			if(decision == ILimiter::DISCARD)
+			int decision = ILimiter::ACCEPT; //bonuses without limiters will be accepted by default
+			if(b->limiter)
 			{
-				undecided.erase(i);
-				i--; continue;
-			}
-			else if(decision == ILimiter::ACCEPT)
-			{
-				accepted.push_back(b);
-				undecided.erase(i);
-				i--; continue;
+				BonusLimitationContext context = {b, *this, out};
+				decision = b->limiter->limit(context);
 			}
+
+			if(decision == ILimiter::ACCEPT)
+				accepted.push_back(std::move(b));
+			else if(decision == ILimiter::NOT_SURE)
+				stillUndecided.push_back(std::move(b));
 			else
-				assert(decision == ILimiter::NOT_SURE);
+				assert(decision == ILimiter::DISCARD);
 		}
+		undecided = std::move(stillUndecided);
 
 		if(undecided.size() == undecidedCount) //we haven't moved a single bonus -> limiters reached a stable state
-			return;
+			break;
 	}
+
+	if(measure)
+		CBonusSystemStatistics::limitingDone(std::chrono::steady_clock::now() - start);
 }
 
 TBonusListPtr CBonusSystemNode::limitBonuses(const BonusList &allBonuses) const
@@ -1047,6 +1374,128 @@ void CBonusSystemNode::treeHasChanged()
 	treeChanged++;
 }
 
+void CBonusSystemNode::nodeHasChanged()
+{
+	//our bonuses are inherited by children, so their caches are outdated as well
+	nodeChanged++;
+	for(CBonusSystemNode * child : children)
+		child->nodeHasChanged();
+}
+
+si64 CBonusSystemNode::getTreeVersion() const
+{
+	//both counters only grow, so the sum changes whenever either of them does
+	return treeChanged + nodeChanged;
+}
+
+CBonusOverlay::CBonusOverlay(const IBonusBearer * Base):
+	base(Base), overlayChanged(0)
+{
+}
+
+void CBonusOverlay::addBonus(const std::shared_ptr<Bonus> & b)
+{
+	added.push_back(b);
+	overlayChanged++;
+}
+
+void CBonusOverlay::addBonuses(const std::vector<Bonus> & bonuses)
+{
+	for(auto & b : bonuses)
+		added.push_back(std::make_shared<Bonus>(b));
+	overlayChanged++;
+}
+
+void CBonusOverlay::removeBonus(const std::shared_ptr<Bonus> & b)
+{
+	if(!(added -= b))
+	{
+		//keep the bonus alive, so that the address can't be reused by another one
+		auto hidden = b;
+		removed.push_back([hidden](const Bonus * other){ return other == hidden.get(); });
+	}
+	overlayChanged++;
+}
+
+void CBonusOverlay::removeBonuses(const CSelector & selector)
+{
+	removed.push_back(selector);
+	overlayChanged++;
+}
+
+const TBonusListPtr CBonusOverlay::getAllBonuses(const CSelector &selector, const CSelector &limit, const CBonusSystemNode *root, const std::string &cachingStr) const
+{
+	//caching strings describe queries on the underlying bearer, so its cached results are still valid for us
+	const TBonusListPtr original = base->getAllBonuses(selector, limit, root, cachingStr);
+
+	BonusList ours;
+	limitAddedBonuses(root).getBonuses(ours, selector, limit);
+
+	//nothing to change - return list of the underlying bearer without copying it
+	if(ours.empty() && removed.empty())
+		return original;
+
+	auto ret = std::make_shared<BonusList>();
+	ret->reserve(original->size() + ours.size());
+	for(auto & b : *original)
+		if(!isHidden(b.get()))
+			ret->push_back(b);
+	for(auto & b : ours)
+		ret->push_back(b);
+	return ret;
+}
+
+BonusList CBonusOverlay::limitAddedBonuses(const CBonusSystemNode * root) const
+{
+	if(!vstd::contains_if(added, [](const std::shared_ptr<Bonus> & b){ return b->limiter; }))
+		return added;
+
+	//limiters are checked against the node at the bottom of overlays, or the external one we are queried against
+	const CBonusSystemNode * node = root;
+	for(const IBonusBearer * bearer = base; !node; )
+	{
+		if(auto overlay = dynamic_cast<const CBonusOverlay *>(bearer))
+			bearer = overlay->getBase();
+		else if(!(node = dynamic_cast<const CBonusSystemNode *>(bearer)))
+			return added; //no node to decide against
+	}
+
+	//same as getAllBonusesWithoutCaching: limit added bonuses together with all bonuses visible through the overlay
+	const TBonusListPtr baseBonuses = base->getAllBonuses(Selector::all, Selector::all, root);
+	BonusList allBonuses, limitedBonuses, ret;
+	for(auto & b : *baseBonuses)
+		if(!isHidden(b.get()))
+			allBonuses.push_back(b);
+	for(auto & b : added)
+		allBonuses.push_back(b);
+
+	allBonuses.eliminateDuplicates();
+	node->limitBonuses(allBonuses, limitedBonuses);
+
+	for(auto & b : added)
+		if(vstd::contains(limitedBonuses, b))
+			ret.push_back(b);
+	return ret;
+}
+
+bool CBonusOverlay::isHidden(const Bonus * b) const
+{
+	for(auto & hides : removed)
+		if(hides(b))
+			return true;
+	return false;
+}
+
+si64 CBonusOverlay::getTreeVersion() const
+{
+	return base->getTreeVersion() + overlayChanged;
+}
+
+const IBonusBearer * CBonusOverlay::getBase() const
+{
+	return base;
+}
+
 int NBonus::valOf(const CBonusSystemNode *obj, Bonus::BonusType type, int subtype)
 {
 	if(obj)
@@ -1166,11 +1615,21 @@ namespace Selector
 		return CSelectFieldEqual<Bonus::BonusSource>(&Bonus::source)(source);
 	}
 
-	DLL_LINKAGE CSelector all([](const Bonus * b){return true;});
+	static CSelector makeAll()
+	{
+		CSelector ret = [](const Bonus *){return true;};
+		ret.setKey(BonusSelectorKey::matchingAll());
+		return ret;
+	}
+
+	DLL_LINKAGE CSelector all(makeAll());
 	DLL_LINKAGE CSelector none([](const Bonus * b){return false;});
 
 	bool DLL_LINKAGE matchesType(const CSelector &sel, Bonus::BonusType type)
 	{
+		if(sel.getRequiredBonusType() >= 0 && sel.getRequiredBonusType() != type)
+			return false;
+
 		Bonus dummy;
 		dummy.type = type;
 		return sel(&dummy);
@@ -1178,6 +1637,9 @@ namespace Selector
 
 	bool DLL_LINKAGE matchesTypeSubtype(const CSelector &sel, Bonus::BonusType type, TBonusSubtype subtype)
 	{
+		if(sel.getRequiredBonusType() >= 0 && sel.getRequiredBonusType() != type)
+			return false;
+
 		Bonus dummy;
 		dummy.type = type;
 		dummy.subtype = subtype;
@@ -26,31 +26,138 @@ typedef std::set<CBonusSystemNode*> TNodes;
 typedef std::set<const CBonusSystemNode*> TCNodes;
 typedef std::vector<CBonusSystemNode *> TNodesVector;
 
+/// Compact description of a selector that only compares bonus fields with constant values.
+/// Selectors with equal valid keys select the same bonuses, so the key can be used for caching their results.
+struct BonusSelectorKey
+{
+	enum EField
+	{
+		TYPE, SUBTYPE, INFO, SOURCE, SOURCE_ID, EFFECT_RANGE, FIELDS_COUNT
+	};
+
+	bool valid; //false if selector can't be described by a key
+	ui8 fields; //bitmask of compared fields, empty for selector matching everything
+	std::array<si32, FIELDS_COUNT> values;
+
+	BonusSelectorKey() : valid(false), fields(0)
+	{
+		values.fill(0);
+	}
+
+	BonusSelectorKey(int field, si32 value) : valid(field >= 0), fields(0)
+	{
+		values.fill(0);
+		if(valid)
+		{
+			fields = 1 << field;
+			values[field] = value;
+		}
+	}
+
+	static BonusSelectorKey matchingAll()
+	{
+		BonusSelectorKey ret;
+		ret.valid = true;
+		return ret;
+	}
+
+	bool has(EField field) const
+	{
+		return valid && (fields & (1 << field));
+	}
+
+	BonusSelectorKey And(const BonusSelectorKey & rhs) const
+	{
+		if(!valid || !rhs.valid)
+			return BonusSelectorKey();
+
+		BonusSelectorKey ret = *this;
+		for(int field = 0; field < FIELDS_COUNT; field++)
+		{
+			if(!rhs.has(static_cast<EField>(field)))
+				continue;
+			if(has(static_cast<EField>(field)) && values[field] != rhs.values[field])
+				return BonusSelectorKey(); //contradicting checks, not worth describing
+			ret.fields |= 1 << field;
+			ret.values[field] = rhs.values[field];
+		}
+		return ret;
+	}
+
+	bool operator==(const BonusSelectorKey & other) const
+	{
+		return valid == other.valid && fields == other.fields && values == other.values;
+	}
+};
+
+struct ShashBonusSelectorKey
+{
+	size_t operator()(const BonusSelectorKey & key) const
+	{
+		size_t ret = std::hash<int>()(key.fields);
+		for(si32 value : key.values)
+			vstd::hash_combine(ret, value);
+		return ret;
+	}
+};
+
 class CSelector : std::function<bool(const Bonus*)>
 {
 	typedef std::function<bool(const Bonus*)> TBase;
+	si32 requiredBonusType; //Bonus::BonusType every selected bonus must have, -1 if not known
+	BonusSelectorKey key;
 public:
-	CSelector() {}
+	CSelector() : requiredBonusType(-1) {}
 	template<typename T>
 	CSelector(const T &t,	//SFINAE trick -> include this c-tor in overload resolution only if parameter is class
 							//(includes functors, lambdas) or function. Without that VC is going mad about ambiguities.
 		typename std::enable_if < boost::mpl::or_ < std::is_class<T>, std::is_function<T >> ::value>::type *dummy = nullptr)
-		: TBase(t)
+		: TBase(t), requiredBonusType(-1)
 	{}
 
-	CSelector(std::nullptr_t)
+	CSelector(std::nullptr_t) : requiredBonusType(-1)
 	{}
 
 	CSelector And(CSelector rhs) const
 	{
 		//lambda may likely outlive "this" (it can be even a temporary) => we copy the OBJECT (not pointer)
 		auto thisCopy = *this;
-		return [thisCopy, rhs](const Bonus *b) mutable { return thisCopy(b) && rhs(b); };
+		CSelector ret = [thisCopy, rhs](const Bonus *b) mutable { return thisCopy(b) && rhs(b); };
+		//both sides have to match, so any known type applies to the result
+		ret.requiredBonusType = requiredBonusType >= 0 ? requiredBonusType : rhs.requiredBonusType;
+		ret.key = key.And(rhs.key);
+		return ret;
 	}
 	CSelector Or(CSelector rhs) const
 	{
 		auto thisCopy = *this;
-		return [thisCopy, rhs](const Bonus *b) mutable { return thisCopy(b) || rhs(b); };
+		CSelector ret = [thisCopy, rhs](const Bonus *b) mutable { return thisCopy(b) || rhs(b); };
+		ret.requiredBonusType = requiredBonusType == rhs.requiredBonusType ? requiredBonusType : -1;
+		return ret;
+	}
+
+	///type of wrapped function, for lambdas it tells where selector was written
+	const std::type_info & getFunctionType() const
+	{
+		return TBase::target_type();
+	}
+	///key describing this selector, valid only for selectors built from Selector field checks
+	const BonusSelectorKey & getKey() const
+	{
+		return key;
+	}
+	///caller guarantees that key describes exactly the bonuses selector matches
+	void setKey(const BonusSelectorKey & Key)
+	{
+		key = Key;
+		if(key.has(BonusSelectorKey::TYPE))
+			requiredBonusType = key.values[BonusSelectorKey::TYPE];
+	}
+
+	///type of bonuses this selector may match or -1 if it may match any, allows selecting from type-indexed bonus lists
+	si32 getRequiredBonusType() const
+	{
+		return requiredBonusType;
 	}
 
 	bool operator()(const Bonus *b) const
@@ -73,12 +180,34 @@ public:
 
 	const BonusList * operator->() const;
 private:
-	mutable int cachedLast;
+	mutable si64 cachedLast;
 	const IBonusBearer * target;
 	CSelector selector;
 	mutable TBonusListPtr data;
 };
 
+/// Statistics of bonus system queries, used to find out which queries dominate a turn.
+/// Collection is switched on at runtime, when it's off the only cost is checking the flag.
+class DLL_LINKAGE CBonusSystemStatistics
+{
+public:
+	static bool isEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+	static void setEnabled(bool on);
+	static void reset();
+	static void print(std::ostream & out); //prints counters and most frequent selectors
+	static void logReport(); //prints to bonus log
+
+	static void queryMade(bool cached, bool hit, const CSelector & selector, const std::string & cachingStr);
+	static void cacheRebuilt(int nodeType);
+	static void limitingDone(std::chrono::steady_clock::duration spent);
+
+private:
+	static std::atomic<bool> enabled;
+};
+
 #define BONUS_TREE_DESERIALIZATION_FIX if(!h.saving && h.smartPointerSerialization) deserializationFix();
 
 #define BONUS_LIST										\
@@ -420,8 +549,6 @@ public:
 
 private:
 	TInternalContainer bonuses;
-	bool belongsToTree;
-	void changed();
 
 public:
 	typedef TInternalContainer::const_reference const_reference;
@@ -430,16 +557,18 @@ public:
 	typedef TInternalContainer::const_iterator const_iterator;
 	typedef TInternalContainer::iterator iterator;
 
-	BonusList(bool BelongsToTree = false);
+	BonusList();
 	BonusList(const BonusList &bonusList);
 	BonusList(BonusList && other);
 	BonusList& operator=(const BonusList &bonusList);
+	BonusList& operator=(BonusList && other);
 
 	// wrapper functions of the STL vector container
 	TInternalContainer::size_type size() const { return bonuses.size(); }
 	void push_back(std::shared_ptr<Bonus> x);
 	TInternalContainer::iterator erase (const int position);
 	void clear();
+	void reserve(TInternalContainer::size_type n) { bonuses.reserve(n); }
 	bool empty() const { return bonuses.empty(); }
 	void resize(TInternalContainer::size_type sz, std::shared_ptr<Bonus> c = nullptr );
 	std::shared_ptr<Bonus> &operator[] (TInternalContainer::size_type n) { return bonuses[n]; }
@@ -556,7 +685,7 @@ public:
 
 struct BonusLimitationContext
 {
-	const std::shared_ptr<Bonus> b;
+	const std::shared_ptr<Bonus> &b;
 	const CBonusSystemNode &node;
 	const BonusList &alreadyAccepted;
 };
@@ -611,6 +740,8 @@ public:
 
 	si32 manaLimit() const; //maximum mana value for this hero (basically 10*knowledge)
 	int getPrimSkillLevel(PrimarySkill::PrimarySkill id) const;
+
+	virtual si64 getTreeVersion() const = 0; //changes every time bonuses visible on this bearer may have changed
 };
 
 class DLL_LINKAGE CBonusSystemNode : public IBonusBearer, public boost::noncopyable
@@ -632,14 +763,29 @@ private:
 	std::string description;
 
 	static const bool cachingEnabled;
-	mutable BonusList cachedBonuses;
-	mutable int cachedLast;
-	static int treeChanged;
+	static si64 treeChanged; //global version, bumped when whole tree has to be invalidated
+	si64 nodeChanged; //local version, bumped when this node or any of its ancestors has changed
 
-	// Setting a value to cachingStr before getting any bonuses caches the result for later requests.
-	// This string needs to be unique, that's why it has to be setted in the following manner:
-	// [property key]_[value] => only for selector
-	mutable std::map<std::string, TBonusListPtr > cachedRequests;
+	// Cache snapshots are never modified once published. Readers atomically load the current one,
+	// writers build a new one and atomically swap it in, so threads querying bonuses don't wait on each other.
+	// Snapshot only holds pointers to shared immutable parts, so publishing a new one doesn't copy bonuses.
+	struct BonusCache
+	{
+		typedef std::map<std::string, TBonusListPtr> TRequests;
+		typedef std::unordered_map<BonusSelectorKey, TBonusListPtr, ShashBonusSelectorKey> TKeyedRequests;
+
+		si64 version; //tree version the snapshot was made for
+		std::shared_ptr<const BonusList> bonuses; //all our bonuses with limiters applied
+		std::shared_ptr<const std::vector<BonusList>> bonusesByType; //same bonuses bucketed by Bonus::BonusType, order within bucket is preserved
+
+		// Setting a value to cachingStr before getting any bonuses caches the result for later requests.
+		// This string needs to be unique, that's why it has to be setted in the following manner:
+		// [property key]_[value] => only for selector
+		std::shared_ptr<const TRequests> requests;
+		// Requests without cachingStr are cached by selector key, if their selector has one.
+		std::shared_ptr<const TKeyedRequests> keyedRequests;
+	};
+	mutable std::shared_ptr<const BonusCache> cache; //access only through std::atomic_* functions
 
 	void getBonusesRec(BonusList &out, const CSelector &selector, const CSelector &limit) const;
 	void getAllBonusesRec(BonusList &out) const;
@@ -700,7 +846,11 @@ public:
 	const std::string &getDescription() const;
 	void setDescription(const std::string &description);
 
+	///invalidates bonus caches of all nodes, use it when bonus objects were modified in-place and may be shared between distant nodes
 	static void treeHasChanged();
+	///invalidates bonus caches of this node and its descendants only, other nodes keep their caches
+	void nodeHasChanged();
+	si64 getTreeVersion() const override;
 
 	template <typename Handler> void serialize(Handler &h, const int version)
 	{
@@ -715,6 +865,36 @@ public:
 	friend class CBonusProxy;
 };
 
+/// Lightweight copy-on-write layer of added and hidden bonuses over any bonus bearer (including other overlays).
+/// Bonus tree and caches of the underlying bearer are not touched, so any number of overlays may be alive at once,
+/// e.g. to evaluate hypothetical spells or artifacts.
+class DLL_LINKAGE CBonusOverlay : public IBonusBearer
+{
+public:
+	explicit CBonusOverlay(const IBonusBearer * Base);
+
+	void addBonus(const std::shared_ptr<Bonus> & b);
+	void addBonuses(const std::vector<Bonus> & bonuses); //copies given bonuses
+	///hides given bonus of the underlying bearer, or drops it if it was added to this overlay
+	void removeBonus(const std::shared_ptr<Bonus> & b);
+	///hides all bonuses of the underlying bearer matching the selector
+	void removeBonuses(const CSelector & selector);
+
+	const TBonusListPtr getAllBonuses(const CSelector &selector, const CSelector &limit, const CBonusSystemNode *root = nullptr, const std::string &cachingStr = "") const override;
+	si64 getTreeVersion() const override;
+
+	const IBonusBearer * getBase() const;
+
+private:
+	const IBonusBearer * base;
+	BonusList added;
+	std::vector<CSelector> removed;
+	si64 overlayChanged; //bumped on every change of this overlay
+
+	BonusList limitAddedBonuses(const CBonusSystemNode * root) const; //added bonuses that pass their limiters
+	bool isHidden(const Bonus * b) const;
+};
+
 namespace NBonus
 {
 	//set of methods that may be safely called with nullptr objs
@@ -736,7 +916,41 @@ public:
 	CSelector operator()(const T &valueToCompareAgainst) const
 	{
 		auto ptr2 = ptr; //We need a COPY because we don't want to reference this (might be outlived by lambda)
-		return [ptr2, valueToCompareAgainst](const Bonus *bonus) {  return bonus->*ptr2 == valueToCompareAgainst; };
+		CSelector ret = [ptr2, valueToCompareAgainst](const Bonus *bonus) {  return bonus->*ptr2 == valueToCompareAgainst; };
+		ret.setKey(BonusSelectorKey(selectorKeyField(ptr), static_cast<si32>(valueToCompareAgainst)));
+		return ret;
+	}
+
+private:
+	//fields that can be described by BonusSelectorKey, -1 for others
+	template<typename U>
+	static int selectorKeyField(U Bonus::*field)
+	{
+		return -1;
+	}
+	static int selectorKeyField(Bonus::BonusType Bonus::*field)
+	{
+		return field == &Bonus::type ? BonusSelectorKey::TYPE : -1;
+	}
+	static int selectorKeyField(si32 Bonus::*field)
+	{
+		if(field == &Bonus::subtype)
+			return BonusSelectorKey::SUBTYPE;
+		if(field == &Bonus::additionalInfo)
+			return BonusSelectorKey::INFO;
+		return -1;
+	}
+	static int selectorKeyField(Bonus::BonusSource Bonus::*field)
+	{
+		return field == &Bonus::source ? BonusSelectorKey::SOURCE : -1;
+	}
+	static int selectorKeyField(ui32 Bonus::*field)
+	{
+		return field == &Bonus::sid ? BonusSelectorKey::SOURCE_ID : -1;
+	}
+	static int selectorKeyField(Bonus::LimitEffect Bonus::*field)
+	{
+		return field == &Bonus::effectRange ? BonusSelectorKey::EFFECT_RANGE : -1;
 	}
 };
 
@@ -981,5 +1195,4 @@ template <class InputIterator>
 void BonusList::insert(const int position, InputIterator first, InputIterator last)
 {
 	bonuses.insert(bonuses.begin() + position, first, last);
-	changed();
 }
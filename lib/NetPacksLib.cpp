@@ -1264,6 +1264,8 @@ DLL_LINKAGE void BattleNextRound::applyGs(CGameState *gs)
 
 	for(auto &obst : gs->curB->obstacles)
 		obst->battleTurnPassed();
+
+	gs->curB->battleStateChanged();
 }
 
 DLL_LINKAGE void BattleSetActiveStack::applyGs(CGameState *gs)
@@ -1304,7 +1306,10 @@ DLL_LINKAGE void BattleTriggerEffect::applyGs(CGameState *gs)
 		auto b = st->getBonusLocalFirst(Selector::source(Bonus::SPELL_EFFECT, SpellID::POISON)
 				.And(Selector::type(Bonus::STACK_HEALTH)));
 		if (b)
+		{
 			b->val = val;
+			st->nodeHasChanged();
+		}
 		break;
 	}
 	case Bonus::ENCHANTER:
@@ -1320,12 +1325,16 @@ DLL_LINKAGE void BattleTriggerEffect::applyGs(CGameState *gs)
 DLL_LINKAGE void BattleObstaclePlaced::applyGs(CGameState *gs)
 {
 	gs->curB->obstacles.push_back(obstacle);
+	gs->curB->battleStateChanged();
 }
 
 DLL_LINKAGE void BattleUpdateGateState::applyGs(CGameState *gs)
 {
 	if(gs->curB)
+	{
 		gs->curB->si.gateState = state;
+		gs->curB->battleStateChanged();
+	}
 }
 
 void BattleResult::applyGs(CGameState *gs)
@@ -1392,6 +1401,7 @@ void BattleStackMoved::applyGs(CGameState *gs)
 		}
 	}
 	s->position = dest;
+	gs->curB->battleStateChanged();
 }
 
 DLL_LINKAGE void BattleStackAttacked::applyGs(CGameState *gs)
@@ -1457,6 +1467,9 @@ DLL_LINKAGE void BattleStackAttacked::applyGs(CGameState *gs)
 	//killed summoned creature should be removed like clone
 	if(killed() && vstd::contains(at->state, EBattleStackState::SUMMONED))
 		at->makeGhost();
+
+	if(killed())
+		gs->curB->battleStateChanged();
 }
 
 DLL_LINKAGE void BattleAttack::applyGs(CGameState * gs)
@@ -1543,7 +1556,7 @@ void actualizeEffect(CStack * s, const Bonus & ef)
 			stackBonus->turnsRemain = std::max(stackBonus->turnsRemain, ef.turnsRemain);
 		}
 	}
-	CBonusSystemNode::treeHasChanged();
+	s->nodeHasChanged();
 }
 
 void actualizeEffect(CStack * s, const std::vector<Bonus> & ef)
@@ -1644,6 +1657,7 @@ DLL_LINKAGE void StacksHealedOrResurrected::applyGs(CGameState *gs)
 				logGlobal->warn("Dead stack %s with positive total HP %d", changedStack->nodeName(), totalHealth);
 
 			changedStack->state.insert(EBattleStackState::ALIVE);
+			gs->curB->battleStateChanged();
 		}
 
 		changedStack->setHealth(elem);
@@ -1699,6 +1713,7 @@ DLL_LINKAGE void ObstaclesRemoved::applyGs(CGameState *gs)
 				}
 			}
 		}
+		gs->curB->battleStateChanged();
 	}
 }
 
@@ -1721,6 +1736,7 @@ DLL_LINKAGE void CatapultAttack::applyGs(CGameState *gs)
 			gs->curB->si.wallState[it.attackedPart] =
 			        SiegeInfo::applyDamage(EWallState::EWallState(gs->curB->si.wallState[it.attackedPart]), it.damageDealt);
 		}
+		gs->curB->battleStateChanged();
 	}
 }
 
@@ -1785,6 +1801,7 @@ DLL_LINKAGE void BattleStacksRemoved::applyGs(CGameState *gs)
 
 		stackIDs.erase(rem_stack);
 	}
+	gs->curB->battleStateChanged();
 }
 
 DLL_LINKAGE void BattleStackAdded::applyGs(CGameState *gs)
@@ -1803,6 +1820,7 @@ DLL_LINKAGE void BattleStackAdded::applyGs(CGameState *gs)
 
 	addedStack->localInit(gs->curB.get());
 	gs->curB->stacks.push_back(addedStack);
+	gs->curB->battleStateChanged();
 
 	newStackID = addedStack->ID;
 }
@@ -20,18 +20,29 @@ bool AccessibilityInfo::accessible(BattleHex tile, const CStack * stack) const
 bool AccessibilityInfo::accessible(BattleHex tile, bool doubleWide, ui8 side) const
 {
 	// All hexes that stack would cover if standing on tile have to be accessible.
-	for(auto hex : CStack::getHexes(tile, doubleWide, side))
-	{
-		// If the hex is out of range then the tile isn't accessible
-		if(!hex.isValid())
-			return false;
-		// If we're no defender which step on gate and the hex isn't accessible, then the tile
-		// isn't accessible
-		else if(at(hex) != EAccessibility::ACCESSIBLE &&
-				!(at(hex) == EAccessibility::GATE && side == BattleSide::DEFENDER))
-		{
-			return false;
-		}
-	}
+	// Second hex is the same as in CStack::getHexes
+	if(!isAccessibleHex(tile, side))
+		return false;
+	if(doubleWide)
+		return isAccessibleHex(side == BattleSide::ATTACKER ? tile - 1 : tile + 1, side);
 	return true;
 }
+
+THexMask AccessibilityInfo::getAccessibleHexes(bool doubleWide, ui8 side) const
+{
+	THexMask ret;
+	for(si16 hex = 0; hex < GameConstants::BFIELD_SIZE; hex++)
+		ret[hex] = accessible(hex, doubleWide, side);
+	return ret;
+}
+
+bool AccessibilityInfo::isAccessibleHex(BattleHex hex, ui8 side) const
+{
+	// If the hex is out of range then the tile isn't accessible
+	if(!hex.isValid())
+		return false;
+	// If we're no defender which step on gate and the hex isn't accessible, then the tile
+	// isn't accessible
+	return at(hex) == EAccessibility::ACCESSIBLE ||
+		(at(hex) == EAccessibility::GATE && side == BattleSide::DEFENDER);
+}
@@ -27,9 +27,14 @@ enum class EAccessibility
 
 
 typedef std::array<EAccessibility, GameConstants::BFIELD_SIZE> TAccessibilityArray;
+typedef std::bitset<GameConstants::BFIELD_SIZE> THexMask;
 
 struct DLL_LINKAGE AccessibilityInfo : TAccessibilityArray
 {
 	bool accessible(BattleHex tile, const CStack * stack) const; //checks for both tiles if stack is double wide
 	bool accessible(BattleHex tile, bool doubleWide, ui8 side) const; //checks for both tiles if stack is double wide
+	THexMask getAccessibleHexes(bool doubleWide, ui8 side) const; //hexes where stack can stand
+
+private:
+	bool isAccessibleHex(BattleHex hex, ui8 side) const;
 };
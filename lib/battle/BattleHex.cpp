@@ -134,6 +134,27 @@ std::vector<BattleHex> BattleHex::neighbouringTiles() const
 	return ret;
 }
 
+const std::array<BattleHex, 6> & BattleHex::getAllNeighbouringTiles() const
+{
+	static const auto neighbours = []()
+	{
+		std::array<std::array<BattleHex, 6>, GameConstants::BFIELD_SIZE> ret;
+		for(si16 hex = 0; hex < GameConstants::BFIELD_SIZE; hex++)
+		{
+			for(EDir dir = EDir(0); dir <= EDir(5); dir = EDir(dir+1))
+			{
+				BattleHex neighbour = BattleHex(hex).cloneInDirection(dir, false);
+				if(neighbour.isAvailable())
+					ret[hex][dir] = neighbour;
+			}
+		}
+		return ret;
+	}();
+
+	assert(isValid());
+	return neighbours[hex];
+}
+
 signed char BattleHex::mutualPosition(BattleHex hex1, BattleHex hex2)
 {
 	for(EDir dir = EDir(0); dir <= EDir(5); dir = EDir(dir+1))
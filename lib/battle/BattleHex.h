@@ -57,6 +57,8 @@ struct DLL_LINKAGE BattleHex //TODO: decide if this should be changed to class f
 	BattleHex cloneInDirection(EDir dir, bool hasToBeValid = true) const;
 	BattleHex operator+(EDir dir) const;
 	std::vector<BattleHex> neighbouringTiles() const;
+	/// Neighbours indexed by direction, INVALID where neighbour isn't available. Precomputed for whole battlefield, hex must be valid
+	const std::array<BattleHex, 6> & getAllNeighbouringTiles() const;
 	static signed char mutualPosition(BattleHex hex1, BattleHex hex2);
 	static char getDistance(BattleHex hex1, BattleHex hex2);
 	static void checkAndPush(BattleHex tile, std::vector<BattleHex> & ret);
@@ -635,6 +635,7 @@ BattleInfo * BattleInfo::setupBattle(int3 tile, ETerrainType terrain, BFieldType
 		}
 	}
 
+	curB->battleStateChanged();
 	return curB;
 }
 
@@ -718,10 +719,17 @@ CStack * BattleInfo::getStack(int stackID, bool onlyAlive)
 BattleInfo::BattleInfo()
 	: round(-1), activeStack(-1), selectedStack(-1), town(nullptr), tile(-1,-1,-1),
 	battlefieldType(BFieldType::NONE), terrainType(ETerrainType::WRONG),
-	tacticsSide(0), tacticDistance(0)
+	tacticsSide(0), tacticDistance(0), stateVersion(0)
 {
 	setBattle(this);
 	setNodeType(BATTLE);
+	battleStateChanged();
+}
+
+void BattleInfo::battleStateChanged()
+{
+	static std::atomic<ui32> lastStateVersion(0);
+	stateVersion = ++lastStateVersion;
 }
 
 CArmedInstance * BattleInfo::battleGetArmyObject(ui8 side) const
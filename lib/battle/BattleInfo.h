@@ -34,6 +34,8 @@ struct DLL_LINKAGE BattleInfo : public CBonusSystemNode, public CBattleInfoCallb
 	ui8 tacticsSide; //which side is requested to play tactics phase
 	ui8 tacticDistance; //how many hexes we can go forward (1 = only hexes adjacent to margin line)
 
+	ui32 stateVersion; //not serialized, new value is given on load
+
 	template <typename Handler> void serialize(Handler &h, const int version)
 	{
 		h & sides;
@@ -56,6 +58,10 @@ struct DLL_LINKAGE BattleInfo : public CBonusSystemNode, public CBattleInfoCallb
 	BattleInfo();
 	~BattleInfo(){};
 
+	/// Should be called whenever stacks move, die or appear and when obstacles or walls change
+	/// Drops accessibility and reachability cached by callbacks
+	void battleStateChanged();
+
 	//////////////////////////////////////////////////////////////////////////
 	CStack * getStack(int stackID, bool onlyAlive = true);
 	using CBattleInfoEssentials::battleGetArmyObject;
@@ -847,6 +847,17 @@ std::vector<std::shared_ptr<const CObstacleInstance>> CBattleInfoCallback::getAl
 }
 
 AccessibilityInfo CBattleInfoCallback::getAccesibility() const
+{
+	if(!duringBattle())
+		return calculateAccesibility();
+
+	return reachabilityCache.getAccessibility(battleGetStateVersion(), [this]()
+	{
+		return calculateAccesibility();
+	});
+}
+
+AccessibilityInfo CBattleInfoCallback::calculateAccesibility() const
 {
 	AccessibilityInfo ret;
 	ret.fill(EAccessibility::ACCESSIBLE);
@@ -964,39 +975,9 @@ ReachabilityInfo CBattleInfoCallback::makeBFS(const AccessibilityInfo &accessibi
 	if(!params.startPosition.isValid()) //if got call for arrow turrets
 		return ret;
 
-	const std::set<BattleHex> quicksands = getStoppers(params.perspective);
-	//const bool twoHexCreature = params.doubleWide;
-
-	std::queue<BattleHex> hexq; //bfs queue
-
-	//first element
-	hexq.push(params.startPosition);
-	ret.distances[params.startPosition] = 0;
-
-	while(!hexq.empty()) //bfs loop
-	{
-		const BattleHex curHex = hexq.front();
-		hexq.pop();
-
-		//walking stack can't step past the quicksands
-		//TODO what if second hex of two-hex creature enters quicksand
-		if(curHex != params.startPosition && vstd::contains(quicksands, curHex))
-			continue;
-
-		const int costToNeighbour = ret.distances[curHex] + 1;
-		for(BattleHex neighbour : curHex.neighbouringTiles())
-		{
-			const bool accessible = accessibility.accessible(neighbour, params.doubleWide, params.side);
-			const int costFoundSoFar = ret.distances[neighbour];
-
-			if(accessible && costToNeighbour < costFoundSoFar)
-			{
-				hexq.push(neighbour);
-				ret.distances[neighbour] = costToNeighbour;
-				ret.predecessors[neighbour] = curHex;
-			}
-		}
-	}
+	const THexMask quicksands = getStoppersMask(params.perspective);
+	const THexMask accessibleHexes = accessibility.getAccessibleHexes(params.doubleWide, params.side);
+	ReachabilityInfo::walk(params.startPosition, accessibleHexes, quicksands, ret.distances, ret.predecessors);
 
 	return ret;
 }
@@ -1009,13 +990,30 @@ ReachabilityInfo CBattleInfoCallback::makeBFS(const CStack * stack) const
 std::set<BattleHex> CBattleInfoCallback::getStoppers(BattlePerspective::BattlePerspective whichSidePerspective) const
 {
 	std::set<BattleHex> ret;
+	const THexMask mask = getStoppersMask(whichSidePerspective);
+	for(si16 hex = 0; hex < GameConstants::BFIELD_SIZE; hex++)
+	{
+		if(mask[hex])
+			ret.insert(BattleHex(hex));
+	}
+
+	return ret;
+}
+
+THexMask CBattleInfoCallback::getStoppersMask(BattlePerspective::BattlePerspective whichSidePerspective) const
+{
+	THexMask ret;
 	RETURN_IF_NOT_BATTLE(ret);
 
 	for(auto &oi : battleGetAllObstacles(whichSidePerspective))
 	{
 		if(battleIsObstacleVisibleForSide(*oi, whichSidePerspective))
 		{
-			range::copy(oi->getStoppingTile(), vstd::set_inserter(ret));
+			for(BattleHex hex : oi->getStoppingTile())
+			{
+				if(hex.isValid())
+					ret[hex] = true;
+			}
 		}
 	}
 
@@ -1096,6 +1094,22 @@ ReachabilityInfo CBattleInfoCallback::getReachability(const CStack *stack) const
 }
 
 ReachabilityInfo CBattleInfoCallback::getReachability(const ReachabilityInfo::Parameters &params) const
+{
+	if(!duringBattle())
+		return calculateReachability(params);
+
+	return reachabilityCache.getReachability(battleGetStateVersion(), params, [&]()
+	{
+		return calculateReachability(params);
+	});
+}
+
+BattleReachabilityCache::Stats CBattleInfoCallback::getReachabilityCacheStats() const
+{
+	return reachabilityCache.getStats();
+}
+
+ReachabilityInfo CBattleInfoCallback::calculateReachability(const ReachabilityInfo::Parameters &params) const
 {
 	if(params.flying)
 		return getFlyingReachability(params);
@@ -1106,11 +1120,13 @@ ReachabilityInfo CBattleInfoCallback::getReachability(const ReachabilityInfo::Pa
 ReachabilityInfo CBattleInfoCallback::getFlyingReachability(const ReachabilityInfo::Parameters &params) const
 {
 	ReachabilityInfo ret;
+	ret.params = params;
 	ret.accessibility = getAccesibility(params.knownAccessible);
+	const THexMask accessibleHexes = ret.accessibility.getAccessibleHexes(params.doubleWide, params.side);
 
 	for(int i = 0; i < GameConstants::BFIELD_SIZE; i++)
 	{
-		if(ret.accessibility.accessible(i, params.doubleWide, params.side))
+		if(accessibleHexes[i])
 		{
 			ret.predecessors[i] = params.startPosition;
 			ret.distances[i] = BattleHex::getDistance(params.startPosition, i);
@@ -1649,3 +1665,86 @@ boost::optional<int> CBattleInfoCallback::battleIsFinished() const
 		return 1;
 	return boost::none;
 }
+
+BattleReachabilityCache::BattleReachabilityCache()
+	: version(0)
+{
+	stats.hits = stats.misses = 0;
+}
+
+BattleReachabilityCache::BattleReachabilityCache(const BattleReachabilityCache &)
+	: BattleReachabilityCache()
+{
+}
+
+BattleReachabilityCache & BattleReachabilityCache::operator=(const BattleReachabilityCache &)
+{
+	boost::unique_lock<boost::mutex> lock(mx);
+	setVersion(0);
+	return *this;
+}
+
+AccessibilityInfo BattleReachabilityCache::getAccessibility(ui32 stateVersion, const std::function<AccessibilityInfo()> & calculate)
+{
+	{
+		boost::unique_lock<boost::mutex> lock(mx);
+		setVersion(stateVersion);
+		if(accessibility)
+		{
+			stats.hits++;
+			return *accessibility;
+		}
+		stats.misses++;
+	}
+
+	AccessibilityInfo ret = calculate();
+
+	boost::unique_lock<boost::mutex> lock(mx);
+	if(version == stateVersion)
+		accessibility = ret;
+	return ret;
+}
+
+ReachabilityInfo BattleReachabilityCache::getReachability(ui32 stateVersion, const ReachabilityInfo::Parameters & params, const std::function<ReachabilityInfo()> & calculate)
+{
+	{
+		boost::unique_lock<boost::mutex> lock(mx);
+		setVersion(stateVersion);
+		for(auto & reachability : reachabilities)
+		{
+			if(reachability.params == params)
+			{
+				stats.hits++;
+				return reachability;
+			}
+		}
+		stats.misses++;
+	}
+
+	ReachabilityInfo ret = calculate();
+
+	boost::unique_lock<boost::mutex> lock(mx);
+	if(version == stateVersion)
+	{
+		if(reachabilities.size() >= MAX_CACHED_REACHABILITIES)
+			reachabilities.clear();
+		reachabilities.push_back(ret);
+	}
+	return ret;
+}
+
+BattleReachabilityCache::Stats BattleReachabilityCache::getStats() const
+{
+	boost::unique_lock<boost::mutex> lock(mx);
+	return stats;
+}
+
+void BattleReachabilityCache::setVersion(ui32 stateVersion)
+{
+	if(version == stateVersion)
+		return;
+
+	version = stateVersion;
+	accessibility.reset();
+	reachabilities.clear();
+}
@@ -31,6 +31,38 @@ struct DLL_LINKAGE AttackableTiles
 	}
 };
 
+/// Accessibility and reachability computed for one state of battle
+/// State is identified by version of BattleInfo, results for previous versions are dropped
+class DLL_LINKAGE BattleReachabilityCache
+{
+public:
+	struct Stats
+	{
+		ui64 hits;
+		ui64 misses;
+	};
+
+	BattleReachabilityCache();
+	BattleReachabilityCache(const BattleReachabilityCache & other); //cached results are not copied
+	BattleReachabilityCache & operator=(const BattleReachabilityCache & other);
+
+	/// Calculation is done without lock so it can use cache too
+	AccessibilityInfo getAccessibility(ui32 stateVersion, const std::function<AccessibilityInfo()> & calculate);
+	ReachabilityInfo getReachability(ui32 stateVersion, const ReachabilityInfo::Parameters & params, const std::function<ReachabilityInfo()> & calculate);
+	Stats getStats() const;
+
+private:
+	static const size_t MAX_CACHED_REACHABILITIES = 64;
+
+	mutable boost::mutex mx;
+	ui32 version;
+	boost::optional<AccessibilityInfo> accessibility;
+	std::vector<ReachabilityInfo> reachabilities;
+	Stats stats;
+
+	void setVersion(ui32 stateVersion);
+};
+
 class DLL_LINKAGE CBattleInfoCallback : public virtual CBattleInfoEssentials
 {
 public:
@@ -103,9 +135,17 @@ public:
 	AccessibilityInfo getAccesibility(const CStack *stack) const; //Hexes ocupied by stack will be marked as accessible.
 	AccessibilityInfo getAccesibility(const std::vector<BattleHex> & accessibleHexes) const; //given hexes will be marked as accessible
 	std::pair<const CStack *, BattleHex> getNearestStack(const CStack * closest, BattleSideOpt side) const;
+	BattleReachabilityCache::Stats getReachabilityCacheStats() const;
 protected:
 	ReachabilityInfo getFlyingReachability(const ReachabilityInfo::Parameters & params) const;
 	ReachabilityInfo makeBFS(const AccessibilityInfo & accessibility, const ReachabilityInfo::Parameters & params) const;
 	ReachabilityInfo makeBFS(const CStack * stack) const; //uses default parameters -> stack position and owner's perspective
 	std::set<BattleHex> getStoppers(BattlePerspective::BattlePerspective whichSidePerspective) const; //get hexes with stopping obstacles (quicksands)
+	THexMask getStoppersMask(BattlePerspective::BattlePerspective whichSidePerspective) const; //same as above, used by BFS
+
+private:
+	mutable BattleReachabilityCache reachabilityCache;
+
+	AccessibilityInfo calculateAccesibility() const;
+	ReachabilityInfo calculateReachability(const ReachabilityInfo::Parameters & params) const;
 };
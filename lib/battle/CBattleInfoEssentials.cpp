@@ -165,6 +165,12 @@ bool CBattleInfoEssentials::battleDoWeKnowAbout(ui8 side) const
 	return p == BattlePerspective::ALL_KNOWING || p == side;
 }
 
+ui32 CBattleInfoEssentials::battleGetStateVersion() const
+{
+	RETURN_IF_NOT_BATTLE(0);
+	return getBattle()->stateVersion;
+}
+
 si8 CBattleInfoEssentials::battleTacticDist() const
 {
 	RETURN_IF_NOT_BATTLE(0);
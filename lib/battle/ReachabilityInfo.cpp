@@ -32,6 +32,17 @@ ReachabilityInfo::Parameters::Parameters(const CStack * Stack)
 	knownAccessible = stack->getHexes();
 }
 
+bool ReachabilityInfo::Parameters::operator==(const Parameters & other) const
+{
+	return stack == other.stack
+		&& side == other.side
+		&& doubleWide == other.doubleWide
+		&& flying == other.flying
+		&& knownAccessible == other.knownAccessible
+		&& startPosition == other.startPosition
+		&& perspective == other.perspective;
+}
+
 ReachabilityInfo::ReachabilityInfo()
 {
 	distances.fill(INFINITE_DIST);
@@ -42,3 +53,35 @@ bool ReachabilityInfo::isReachable(BattleHex hex) const
 {
 	return distances[hex] < INFINITE_DIST;
 }
+
+void ReachabilityInfo::walk(BattleHex start, const THexMask & accessibleHexes, const THexMask & stoppers, TDistances & distances, TPredecessors & predecessors)
+{
+	//bfs queue, every hex gets into it at most once since distances are only set for hexes that weren't reached yet
+	std::array<BattleHex, GameConstants::BFIELD_SIZE> hexq;
+	size_t queueBegin = 0, queueEnd = 0;
+
+	//first element
+	hexq[queueEnd++] = start;
+	distances[start] = 0;
+
+	while(queueBegin < queueEnd) //bfs loop
+	{
+		const BattleHex curHex = hexq[queueBegin++];
+
+		//walking stack can't step past the quicksands
+		//TODO what if second hex of two-hex creature enters quicksand
+		if(curHex != start && stoppers[curHex])
+			continue;
+
+		const int costToNeighbour = distances[curHex] + 1;
+		for(BattleHex neighbour : curHex.getAllNeighbouringTiles())
+		{
+			if(neighbour.isValid() && accessibleHexes[neighbour] && costToNeighbour < distances[neighbour])
+			{
+				hexq[queueEnd++] = neighbour;
+				distances[neighbour] = costToNeighbour;
+				predecessors[neighbour] = curHex;
+			}
+		}
+	}
+}
@@ -37,6 +37,8 @@ struct DLL_LINKAGE ReachabilityInfo
 
 		Parameters();
 		Parameters(const CStack * Stack);
+
+		bool operator==(const Parameters & other) const;
 	};
 
 	Parameters params;
@@ -47,6 +49,10 @@ struct DLL_LINKAGE ReachabilityInfo
 	ReachabilityInfo();
 
 	bool isReachable(BattleHex hex) const;
+
+	/// BFS from start over accessible hexes, walking stack can't step past stoppers (eg. quicksands)
+	/// Distances and predecessors are only set for reached hexes, others must be initialized by caller
+	static void walk(BattleHex start, const THexMask & accessibleHexes, const THexMask & stoppers, TDistances & distances, TPredecessors & predecessors);
 };
 
 
@@ -64,24 +64,9 @@ ui32 CGHeroInstance::getTileCost(const TerrainTile &dest, const TerrainTile &fro
 	unsigned ret = GameConstants::BASE_MOVEMENT_COST;
 
 	//if there is road both on dest and src tiles - use road movement cost
-	if(dest.roadType != ERoadType::NO_ROAD && from.roadType != ERoadType::NO_ROAD)
+	if(ui32 roadCost = getRoadCost(dest, from))
 	{
-		int road = std::min(dest.roadType,from.roadType); //used road ID
-		switch(road)
-		{
-		case ERoadType::DIRT_ROAD:
-			ret = 75;
-			break;
-		case ERoadType::GRAVEL_ROAD:
-			ret = 65;
-			break;
-		case ERoadType::COBBLESTONE_ROAD:
-			ret = 50;
-			break;
-		default:
-			logGlobal->error("Unknown road type: %d", road);
-			break;
-		}
+		ret = roadCost;
 	}
 	else if(ti->nativeTerrain != from.terType && !ti->hasBonusOfType(Bonus::NO_TERRAIN_PENALTY, from.terType))
 	{
@@ -93,6 +78,26 @@ ui32 CGHeroInstance::getTileCost(const TerrainTile &dest, const TerrainTile &fro
 	return ret;
 }
 
+ui32 CGHeroInstance::getRoadCost(const TerrainTile &dest, const TerrainTile &from)
+{
+	if(dest.roadType == ERoadType::NO_ROAD || from.roadType == ERoadType::NO_ROAD)
+		return 0;
+
+	int road = std::min(dest.roadType,from.roadType); //used road ID
+	switch(road)
+	{
+	case ERoadType::DIRT_ROAD:
+		return 75;
+	case ERoadType::GRAVEL_ROAD:
+		return 65;
+	case ERoadType::COBBLESTONE_ROAD:
+		return 50;
+	default:
+		logGlobal->error("Unknown road type: %d", road);
+		return GameConstants::BASE_MOVEMENT_COST;
+	}
+}
+
 int CGHeroInstance::getNativeTerrain() const
 {
 	// NOTE: in H3 neutral stacks will ignore terrain penalty only if placed as topmost stack(s) in hero army.
@@ -749,6 +754,7 @@ void CGHeroInstance::Updatespecialty() //TODO: calculate special value of bonuse
 					}
 				}
 			}
+			hs->nodeHasChanged(); //values were updated in-place
 		}
 	}
 }
@@ -845,7 +851,7 @@ void CGHeroInstance::updateSkill(SecondarySkill which, int val)
 		addNewBonus(bonus);
 	}
 
-	CBonusSystemNode::treeHasChanged();
+	nodeHasChanged();
 }
 void CGHeroInstance::setPropertyDer( ui8 what, ui32 val )
 {
@@ -1456,7 +1462,7 @@ void CGHeroInstance::setPrimarySkill(PrimarySkill::PrimarySkill primarySkill, si
 		{
 			skill->val += value;
 		}
-		CBonusSystemNode::treeHasChanged();
+		nodeHasChanged();
 	}
 	else if(primarySkill == PrimarySkill::EXPERIENCE)
 	{
@@ -151,6 +151,7 @@ public:
 	bool needsLastStack()const override;
 	TFaction getFaction() const;
 	ui32 getTileCost(const TerrainTile &dest, const TerrainTile &from, const TurnInfo * ti) const; //move cost - applying pathfinding skill, road and terrain modifiers. NOT includes diagonal move penalty, last move levelling
+	static ui32 getRoadCost(const TerrainTile &dest, const TerrainTile &from); //move cost along road, 0 if there is no road on both tiles
 	int getNativeTerrain() const;
 	ui32 getLowestCreatureSpeed() const;
 	int3 getPosition(bool h3m = false) const; //h3m=true - returns position of hero object; h3m=false - returns position of hero 'manifestation'
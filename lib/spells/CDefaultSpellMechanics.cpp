@@ -382,10 +382,10 @@ void DefaultSpellMechanics::battleLog(std::vector<MetaString> & logLines, const
 			attackedStack->addNameReplacement(line);
 
 			//todo: display effect from only this cast
-			TBonusListPtr bl = attackedStack->getBonuses(Selector::type(Bonus::STACK_HEALTH));
-			const int fullHP = bl->totalValue();
-			bl->remove_if(Selector::source(Bonus::SPELL_EFFECT, SpellID::AGE));
-			line.addReplacement(fullHP - bl->totalValue());
+			BonusList bl = *(attackedStack->getBonuses(Selector::type(Bonus::STACK_HEALTH))); //copy, returned list may be cached
+			const int fullHP = bl.totalValue();
+			bl.remove_if(Selector::source(Bonus::SPELL_EFFECT, SpellID::AGE));
+			line.addReplacement(fullHP - bl.totalValue());
 			logLines.push_back(line);
 		}
 		break;
@@ -1482,6 +1482,13 @@ void CGameHandler::setPortalDwelling(const CGTownInstance * town, bool forced=fa
 void CGameHandler::newTurn()
 {
 	logGlobal->trace("Turn %d", gs->day+1);
+	if(CBonusSystemStatistics::isEnabled())
+	{
+		//queries of finished day, mostly made by AI turns and previous newTurn
+		logBonus->info("Bonus system statistics of day %d:", gs->day);
+		CBonusSystemStatistics::logReport();
+		CBonusSystemStatistics::reset();
+	}
 	NewTurn n;
 	n.specialWeek = NewTurn::NO_ACTION;
 	n.creatureid = CreatureID::NONE;
@@ -545,7 +545,8 @@ static void handleCommandOptions(int argc, char *argv[])
 		("uuid", po::value<std::string>(), "")
 		("enable-shm-uuid", "use UUID for shared memory identifier")
 		("enable-shm", "enable usage of shared memory")
-		("port", po::value<ui16>(), "port at which server will listen to connections from client");
+		("port", po::value<ui16>(), "port at which server will listen to connections from client")
+		("bonus-stats", "collect bonus system statistics, they are logged at start of every day and on exit");
 
 	if(argc > 1)
 	{
@@ -628,6 +629,8 @@ int main(int argc, char * argv[])
 	preinitDLL(console);
 	settings.init();
 	logConfig.configure();
+	if(cmdLineOptions.count("bonus-stats"))
+		CBonusSystemStatistics::setEnabled(true);
 
 	loadDLLClasses();
 	srand ( (ui32)time(nullptr) );
@@ -665,6 +668,8 @@ int main(int argc, char * argv[])
 	CAndroidVMHelper envHelper;
 	envHelper.callStaticVoidMethod(CAndroidVMHelper::NATIVE_METHODS_DEFAULT_CLASS, "killServer");
 #endif
+	if(CBonusSystemStatistics::isEnabled())
+		CBonusSystemStatistics::logReport();
 	vstd::clear_pointer(VLC);
 	CResourceHandler::clear();
 	return 0;
@@ -0,0 +1,34 @@
+/*
+ * CThreadHelperTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../lib/CThreadHelper.h"
+
+TEST(CThreadHelperTest, runsEveryTaskOnce)
+{
+	const int taskCount = 100;
+	std::vector<std::atomic<int>> counters(taskCount);
+	for(auto & counter : counters)
+		counter = 0;
+
+	std::vector<Task> tasks;
+	for(int i = 0; i < taskCount; i++)
+		tasks.push_back([&counters, i](){ counters[i]++; });
+
+	//run several times - helper must release its threads cleanly every time
+	for(int run = 1; run <= 3; run++)
+	{
+		CThreadHelper helper(&tasks, 4);
+		helper.run();
+
+		for(int i = 0; i < taskCount; i++)
+			EXPECT_EQ(counters[i], run);
+	}
+}
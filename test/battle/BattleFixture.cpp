@@ -0,0 +1,53 @@
+/*
+ * BattleFixture.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+#include "StdInc.h"
+
+#include "BattleFixture.h"
+
+#include "../../lib/CStack.h"
+
+BattleFixture::BattleFixture()
+{
+	armies[BattleSide::ATTACKER].tempOwner = PlayerColor(0);
+	armies[BattleSide::DEFENDER].tempOwner = PlayerColor(1);
+}
+
+void BattleFixture::addStack(ui8 side, CreatureID creature, TQuantity count)
+{
+	armies[side].putStack(armies[side].getFreeSlot(), new CStackInstance(creature, count));
+}
+
+void BattleFixture::startBattle(const std::vector<BattleHex> & positions)
+{
+	const CArmedInstance * armyPtrs[2] = {&armies[0], &armies[1]};
+	const CGHeroInstance * heroes[2] = {nullptr, nullptr};
+	battle.reset(BattleInfo::setupBattle(int3(), ETerrainType::GRASS, BFieldType::GRASS_HILLS, armyPtrs, heroes, false, nullptr));
+	battle->obstacles.clear();
+
+	std::vector<CStack *> stacks = battle->stacks;
+	std::sort(stacks.begin(), stacks.end(), [](const CStack * lhs, const CStack * rhs)
+	{
+		return std::make_pair(lhs->side, lhs->slot) < std::make_pair(rhs->side, rhs->slot);
+	});
+	ASSERT_EQ(stacks.size(), positions.size());
+	for(size_t i = 0; i < stacks.size(); i++)
+		stacks[i]->position = positions[i];
+	battle->battleStateChanged();
+}
+
+CStack * BattleFixture::getStack(ui8 side, int slot) const
+{
+	for(CStack * stack : battle->stacks)
+	{
+		if(stack->side == side && stack->slot == SlotID(slot))
+			return stack;
+	}
+	return nullptr;
+}
@@ -0,0 +1,31 @@
+/*
+ * BattleFixture.h, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#pragma once
+
+#include "../../lib/battle/BattleInfo.h"
+#include "../../lib/mapObjects/CArmedInstance.h"
+
+/// Sets up real battle between two armies without heroes for tests of battle AI
+class BattleFixture : public ::testing::Test
+{
+public:
+	BattleFixture();
+
+	void addStack(ui8 side, CreatureID creature, TQuantity count);
+
+	/// Starts battle on open field, stacks of attacker are placed on given hexes in order of their slots, then ones of defender
+	void startBattle(const std::vector<BattleHex> & positions);
+
+	CStack * getStack(ui8 side, int slot) const;
+
+	CArmedInstance armies[2];
+	std::unique_ptr<BattleInfo> battle;
+};
@@ -10,6 +10,7 @@
 
 #include "StdInc.h"
 #include "../lib/battle/BattleHex.h"
+#include "../lib/GameConstants.h"
 
 TEST(BattleHexTest, getNeighbouringTiles){
 	BattleHex mainHex;
@@ -116,3 +117,17 @@ TEST(BattleHexTest, moveEDir)
 	mainHex.moveInDirection(BattleHex::EDir::BOTTOM_LEFT);
 	EXPECT_EQ(mainHex, 20);
 }
+
+TEST(BattleHexTest, allNeighbouringTilesMatchNeighbouringTiles)
+{
+	for(si16 hex = 0; hex < GameConstants::BFIELD_SIZE; hex++)
+	{
+		std::vector<BattleHex> fromTable;
+		for(BattleHex neighbour : BattleHex(hex).getAllNeighbouringTiles())
+		{
+			if(neighbour.isValid())
+				fromTable.push_back(neighbour);
+		}
+		EXPECT_EQ(fromTable, BattleHex(hex).neighbouringTiles());
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * BattleReachabilityCacheTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../../lib/battle/CBattleInfoCallback.h"
+
+class BattleReachabilityCacheTest : public ::testing::Test
+{
+public:
+	BattleReachabilityCacheTest()
+		: calculations(0)
+	{
+	}
+
+	ReachabilityInfo calculate(BattleHex startPosition)
+	{
+		calculations++;
+		ReachabilityInfo ret;
+		ret.params.startPosition = startPosition;
+		ret.distances[startPosition] = 0;
+		return ret;
+	}
+
+	ReachabilityInfo get(ui32 version, BattleHex startPosition)
+	{
+		ReachabilityInfo::Parameters params;
+		params.startPosition = startPosition;
+		return cache.getReachability(version, params, [&]()
+		{
+			return calculate(startPosition);
+		});
+	}
+
+	BattleReachabilityCache cache;
+	int calculations;
+};
+
+TEST_F(BattleReachabilityCacheTest, sameStateIsCalculatedOnce)
+{
+	EXPECT_EQ(get(1, 20).distances[20], 0);
+	EXPECT_EQ(get(1, 20).distances[20], 0);
+	EXPECT_EQ(get(1, 30).distances[30], 0);
+	EXPECT_EQ(get(1, 30).distances[20], ReachabilityInfo::INFINITE_DIST);
+	EXPECT_EQ(calculations, 2);
+
+	auto stats = cache.getStats();
+	EXPECT_EQ(stats.hits, 2);
+	EXPECT_EQ(stats.misses, 2);
+}
+
+TEST_F(BattleReachabilityCacheTest, newStateDropsResults)
+{
+	get(1, 20);
+	get(2, 20);
+	get(2, 20);
+	EXPECT_EQ(calculations, 2);
+
+	//copy doesn't share results
+	ReachabilityInfo::Parameters params;
+	params.startPosition = 20;
+	BattleReachabilityCache copy(cache);
+	copy.getReachability(2, params, [&]()
+	{
+		return calculate(20);
+	});
+	EXPECT_EQ(calculations, 3);
+}
+
+TEST_F(BattleReachabilityCacheTest, accessibilityIsCached)
+{
+	auto calculateAccessibility = [&]()
+	{
+		calculations++;
+		AccessibilityInfo ret;
+		ret.fill(EAccessibility::ACCESSIBLE);
+		return ret;
+	};
+	cache.getAccessibility(1, calculateAccessibility);
+	EXPECT_EQ(cache.getAccessibility(1, calculateAccessibility)[50], EAccessibility::ACCESSIBLE);
+	cache.getAccessibility(2, calculateAccessibility);
+	EXPECT_EQ(calculations, 2);
+}
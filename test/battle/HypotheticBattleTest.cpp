@@ -0,0 +1,196 @@
+/*
+ * HypotheticBattleTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "BattleFixture.h"
+#include "../../AI/BattleAI/HypotheticBattle.h"
+#include "../../lib/CStack.h"
+#include "../../lib/battle/BattleAttackInfo.h"
+
+namespace
+{
+	const CreatureID PIKEMAN(0);
+	const CreatureID ARCHER(2);
+}
+
+class HypotheticBattleTest : public BattleFixture
+{
+public:
+	static const HypotheticBattle::Unit * getUnit(const HypotheticBattle & sim, ui32 stackID)
+	{
+		return sim.getUnit(stackID);
+	}
+};
+
+TEST_F(HypotheticBattleTest, distancesMatchRealBattle)
+{
+	addStack(BattleSide::ATTACKER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 10);
+	startBattle({BattleHex(2, 5), BattleHex(5, 5), BattleHex(5, 4)});
+
+	const CStack * pikemen = getStack(BattleSide::ATTACKER, 0);
+	HypotheticBattle sim(battle.get(), 1);
+	const auto expected = battle->battleGetDistances(pikemen, pikemen->position);
+	const auto actual = sim.getDistances(pikemen->ID);
+	for(int i = 0; i < GameConstants::BFIELD_SIZE; i++)
+	{
+		if(BattleHex(i).isAvailable())
+		{
+			EXPECT_EQ(actual[i], expected[i]) << "hex " << i;
+		}
+	}
+	EXPECT_EQ(actual[BattleHex(4, 5)], 2);
+	EXPECT_EQ(actual[BattleHex(5, 5)], ReachabilityInfo::INFINITE_DIST);
+}
+
+TEST_F(HypotheticBattleTest, moveOnlyChangesCopy)
+{
+	addStack(BattleSide::ATTACKER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 10);
+	startBattle({BattleHex(2, 5), BattleHex(14, 5)});
+
+	const CStack * pikemen = getStack(BattleSide::ATTACKER, 0);
+	HypotheticBattle sim(battle.get(), 1);
+	HypotheticBattle copy = sim;
+	copy.makeMove(pikemen->ID, BattleHex(6, 5));
+
+	EXPECT_EQ(getUnit(copy, pikemen->ID)->position, BattleHex(6, 5));
+	EXPECT_TRUE(getUnit(copy, pikemen->ID)->moved);
+	EXPECT_EQ(copy.getUnitAt(BattleHex(6, 5))->stack, pikemen);
+	EXPECT_TRUE(copy.getUnitAt(BattleHex(2, 5)) == nullptr);
+	EXPECT_EQ(copy.getDistances(pikemen->ID)[BattleHex(2, 5)], 4);
+
+	EXPECT_EQ(getUnit(sim, pikemen->ID)->position, BattleHex(2, 5));
+	EXPECT_FALSE(getUnit(sim, pikemen->ID)->moved);
+	EXPECT_EQ(pikemen->position, BattleHex(2, 5));
+}
+
+TEST_F(HypotheticBattleTest, meleeAttackIsRetaliated)
+{
+	addStack(BattleSide::ATTACKER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 10);
+	startBattle({BattleHex(2, 5), BattleHex(6, 5)});
+
+	const CStack * attacker = getStack(BattleSide::ATTACKER, 0);
+	const CStack * defender = getStack(BattleSide::DEFENDER, 0);
+	const TDmgRange range = battle->calculateDmgRange(BattleAttackInfo(attacker, defender, false));
+
+	HypotheticBattle sim(battle.get(), 1);
+	sim.makeMeleeAttack(attacker->ID, defender->ID, BattleHex(5, 5));
+
+	auto attackerUnit = getUnit(sim, attacker->ID);
+	auto defenderUnit = getUnit(sim, defender->ID);
+	const si64 dealt = defender->health.available() - defenderUnit->health.available();
+	EXPECT_GE(dealt, range.first);
+	EXPECT_LE(dealt, range.second);
+	EXPECT_EQ(attackerUnit->position, BattleHex(5, 5));
+	EXPECT_TRUE(attackerUnit->moved);
+
+	//only one retaliation per round
+	EXPECT_LT(attackerUnit->health.available(), attacker->health.available());
+	EXPECT_EQ(defenderUnit->retaliations, defender->counterAttacks.available() - 1);
+	EXPECT_EQ(attackerUnit->retaliations, attacker->counterAttacks.available());
+	const si64 afterRetaliation = attackerUnit->health.available();
+	sim.makeMeleeAttack(attacker->ID, defender->ID, BattleHex(5, 5));
+	EXPECT_EQ(attackerUnit->health.available(), afterRetaliation);
+
+	sim.nextRound();
+	EXPECT_EQ(defenderUnit->retaliations, defender->counterAttacks.total());
+	EXPECT_FALSE(attackerUnit->moved);
+	EXPECT_EQ(sim.getRoundsPassed(), 1);
+}
+
+TEST_F(HypotheticBattleTest, shotUsesAmmo)
+{
+	addStack(BattleSide::ATTACKER, ARCHER, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 10);
+	startBattle({BattleHex(1, 5), BattleHex(14, 5)});
+
+	const CStack * archers = getStack(BattleSide::ATTACKER, 0);
+	const CStack * pikemen = getStack(BattleSide::DEFENDER, 0);
+	const TDmgRange range = battle->calculateDmgRange(BattleAttackInfo(archers, pikemen, true));
+
+	HypotheticBattle sim(battle.get(), 1);
+	ASSERT_TRUE(sim.canShoot(archers->ID));
+	sim.makeShot(archers->ID, pikemen->ID);
+
+	const si64 dealt = pikemen->health.available() - getUnit(sim, pikemen->ID)->health.available();
+	EXPECT_GE(dealt, range.first);
+	EXPECT_LE(dealt, range.second);
+	EXPECT_EQ(getUnit(sim, archers->ID)->shots, archers->shots.available() - 1);
+	EXPECT_EQ(getUnit(sim, archers->ID)->health.available(), archers->health.available()); //no ranged retaliation
+
+	//enemy standing next to shooter blocks it
+	sim.makeMove(pikemen->ID, BattleHex(2, 5));
+	EXPECT_FALSE(sim.canShoot(archers->ID));
+}
+
+TEST_F(HypotheticBattleTest, ammoCartKeepsShots)
+{
+	addStack(BattleSide::ATTACKER, ARCHER, 10);
+	addStack(BattleSide::ATTACKER, CreatureID(CreatureID::AMMO_CART), 1);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 10);
+	startBattle({BattleHex(1, 5), BattleHex(2, 9), BattleHex(14, 5)});
+
+	const CStack * archers = getStack(BattleSide::ATTACKER, 0);
+	const CStack * ammoCart = getStack(BattleSide::ATTACKER, 1);
+	const CStack * pikemen = getStack(BattleSide::DEFENDER, 0);
+
+	HypotheticBattle sim(battle.get(), 1);
+	sim.makeShot(archers->ID, pikemen->ID);
+	EXPECT_EQ(getUnit(sim, archers->ID)->shots, archers->shots.available());
+
+	//once cart is destroyed shots are used again
+	HypotheticBattle withoutCart(battle.get(), 1);
+	for(int i = 0; i < 100 && getUnit(withoutCart, ammoCart->ID)->alive(); i++)
+		withoutCart.makeShot(pikemen->ID, ammoCart->ID);
+	ASSERT_FALSE(getUnit(withoutCart, ammoCart->ID)->alive());
+	withoutCart.makeShot(archers->ID, pikemen->ID);
+	EXPECT_EQ(getUnit(withoutCart, archers->ID)->shots, archers->shots.available() - 1);
+}
+
+TEST_F(HypotheticBattleTest, sameSeedGivesSameBattle)
+{
+	addStack(BattleSide::ATTACKER, ARCHER, 10);
+	addStack(BattleSide::ATTACKER, PIKEMAN, 20);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 30);
+	startBattle({BattleHex(1, 5), BattleHex(2, 7), BattleHex(6, 6)});
+
+	const CStack * archers = getStack(BattleSide::ATTACKER, 0);
+	const CStack * pikemen = getStack(BattleSide::ATTACKER, 1);
+	const CStack * enemy = getStack(BattleSide::DEFENDER, 0);
+
+	auto play = [&](ui64 seed) -> std::vector<si64>
+	{
+		HypotheticBattle sim(battle.get(), seed);
+		std::vector<si64> health;
+		for(int round = 0; round < 5 && !sim.getWinner(); round++)
+		{
+			if(sim.canShoot(archers->ID))
+				sim.makeShot(archers->ID, enemy->ID);
+			sim.makeMeleeAttack(pikemen->ID, enemy->ID, BattleHex(5, 6));
+			sim.nextRound();
+			for(auto & unit : sim.getUnits())
+				health.push_back(unit.health.available());
+		}
+		return health;
+	};
+
+	const auto first = play(42);
+	EXPECT_FALSE(first.empty());
+	EXPECT_EQ(play(42), first);
+
+	//damage is rolled from range, so some other seed has to give different result
+	bool differs = false;
+	for(ui64 seed = 1; seed < 20 && !differs; seed++)
+		differs = play(seed) != first;
+	EXPECT_TRUE(differs);
+}
@@ -0,0 +1,73 @@
+/*
+ * PotentialTargetsTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "BattleFixture.h"
+#include "../../AI/BattleAI/PotentialTargets.h"
+#include "../../lib/CStack.h"
+
+namespace
+{
+	const CreatureID PIKEMAN(0);
+}
+
+class PotentialTargetsTest : public BattleFixture
+{
+public:
+	void addAttack(const CStack * attacker, const CStack * enemy, BattleHex tile, int damageDealt)
+	{
+		AttackPossibility ap = {enemy, tile, BattleAttackInfo(attacker, enemy, false), damageDealt, 0, 0};
+		targets.possibleAttacks.push_back(ap);
+	}
+
+	PotentialTargets targets;
+};
+
+TEST_F(PotentialTargetsTest, equalAttacksPreferLeastThreatenedHex)
+{
+	addStack(BattleSide::ATTACKER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 20);
+	startBattle({BattleHex(2, 5), BattleHex(8, 5), BattleHex(13, 5)});
+
+	const CStack * ours = getStack(BattleSide::ATTACKER, 0);
+	const CStack * enemy = getStack(BattleSide::DEFENDER, 0);
+
+	ThreatMap threats;
+	threats.reset(battle.get());
+	const ThreatMap::TDamages & suffered = threats.getSufferedDamage(ours);
+
+	//second enemy reaches only the side of first one that is closer to it
+	const BattleHex farSide(7, 5), nearSide(9, 5);
+	ASSERT_GT(suffered[nearSide], suffered[farSide]);
+
+	addAttack(ours, enemy, nearSide, 100);
+	addAttack(ours, enemy, farSide, 100);
+	EXPECT_EQ(targets.bestAction().tile, nearSide);
+	EXPECT_EQ(targets.bestAction(threats).tile, farSide);
+}
+
+TEST_F(PotentialTargetsTest, threatsDoNotOverrideBetterAttack)
+{
+	addStack(BattleSide::ATTACKER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 20);
+	startBattle({BattleHex(2, 5), BattleHex(8, 5), BattleHex(13, 5)});
+
+	const CStack * ours = getStack(BattleSide::ATTACKER, 0);
+	const CStack * enemy = getStack(BattleSide::DEFENDER, 0);
+
+	ThreatMap threats;
+	threats.reset(battle.get());
+
+	addAttack(ours, enemy, BattleHex(7, 5), 100);
+	addAttack(ours, enemy, BattleHex(9, 5), 101);
+	EXPECT_EQ(targets.bestAction(threats).tile, BattleHex(9, 5));
+}
@@ -0,0 +1,96 @@
+/*
+ * ThreatMapTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "BattleFixture.h"
+#include "../../AI/BattleAI/ThreatMap.h"
+#include "../../lib/CStack.h"
+
+namespace
+{
+	const CreatureID PIKEMAN(0);
+	const CreatureID ARCHER(2);
+}
+
+class ThreatMapTest : public BattleFixture
+{
+public:
+	/// Map kept since battle start must give same results as one built from scratch for current state
+	void expectSameAsFresh(ThreatMap & cached, const CStack * endangered, const std::string & context)
+	{
+		ThreatMap fresh;
+		fresh.reset(battle.get());
+
+		const ThreatMap::TDamages expected = fresh.getSufferedDamage(endangered);
+		const ThreatMap::TDamages actual = cached.getSufferedDamage(endangered);
+		for(int i = 0; i < GameConstants::BFIELD_SIZE; i++)
+		{
+			if(!BattleHex(i).isAvailable())
+				continue;
+
+			EXPECT_EQ(actual[i], expected[i]) << context << ", hex " << i;
+
+			const auto expectedThreats = fresh.getThreats(endangered, i);
+			const auto actualThreats = cached.getThreats(endangered, i);
+			ASSERT_EQ(actualThreats.size(), expectedThreats.size()) << context << ", hex " << i;
+			for(size_t j = 0; j < expectedThreats.size(); j++)
+			{
+				EXPECT_EQ(actualThreats[j].attacker, expectedThreats[j].attacker) << context << ", hex " << i;
+				EXPECT_EQ(actualThreats[j].shooting, expectedThreats[j].shooting) << context << ", hex " << i;
+				EXPECT_EQ(actualThreats[j].chargedFields, expectedThreats[j].chargedFields) << context << ", hex " << i;
+			}
+		}
+	}
+};
+
+TEST_F(ThreatMapTest, cachedResultsMatchFreshMap)
+{
+	addStack(BattleSide::ATTACKER, PIKEMAN, 10);
+	addStack(BattleSide::DEFENDER, ARCHER, 10);
+	addStack(BattleSide::DEFENDER, PIKEMAN, 20);
+	startBattle({BattleHex(2, 5), BattleHex(14, 5), BattleHex(10, 5)});
+
+	CStack * ours = getStack(BattleSide::ATTACKER, 0);
+	CStack * archers = getStack(BattleSide::DEFENDER, 0);
+	CStack * enemy = getStack(BattleSide::DEFENDER, 1);
+
+	ThreatMap cached;
+	cached.reset(battle.get());
+	expectSameAsFresh(cached, ours, "start");
+	EXPECT_GT(cached.getSufferedDamage(ours)[BattleHex(9, 5)], cached.getSufferedDamage(ours)[BattleHex(1, 5)]);
+	expectSameAsFresh(cached, ours, "unchanged");
+
+	enemy->position = BattleHex(4, 5);
+	battle->battleStateChanged();
+	expectSameAsFresh(cached, ours, "enemy moved");
+
+	//archers can't shoot with our stack next to them
+	ours->position = BattleHex(13, 5);
+	battle->battleStateChanged();
+	expectSameAsFresh(cached, ours, "archers blocked");
+	EXPECT_FALSE(cached.getThreats(ours, BattleHex(2, 5)).empty());
+	for(const BattleAttackInfo & threat : cached.getThreats(ours, BattleHex(1, 1)))
+	{
+		EXPECT_NE(threat.attacker, archers);
+	}
+
+	int32_t damage = 50;
+	enemy->health.damage(damage);
+	expectSameAsFresh(cached, ours, "enemy damaged");
+
+	ours->addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::PRIMARY_SKILL, Bonus::OTHER, 10, 0, PrimarySkill::DEFENSE));
+	expectSameAsFresh(cached, ours, "defense raised");
+
+	damage = enemy->health.available();
+	enemy->health.damage(damage);
+	battle->battleStateChanged();
+	expectSameAsFresh(cached, ours, "enemy killed");
+	expectSameAsFresh(cached, archers, "other side");
+}
@@ -0,0 +1,448 @@
+/*
+ * PathfinderBenchmark.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../CVcmiTestConfig.h"
+#include "../mock/mock_IGameCallback.h"
+
+#include "../../lib/CGameState.h"
+#include "../../lib/CHeroHandler.h"
+#include "../../lib/CPathfinder.h"
+#include "../../lib/CPlayerState.h"
+#include "../../lib/CStopWatch.h"
+#include "../../lib/JsonNode.h"
+#include "../../lib/StartInfo.h"
+#include "../../lib/VCMI_Lib.h"
+#include "../../lib/mapObjects/CGHeroInstance.h"
+#include "../../lib/mapObjects/MiscObjects.h"
+#include "../../lib/mapping/CMap.h"
+#include "../../lib/rmg/CMapGenOptions.h"
+#include "../pathfinder/HeapQueue.h"
+
+/// Measures adventure map pathfinder on bundled test maps and random maps of every size
+///
+/// Usage: vcmipathbench [--golden FILE] [--update-golden] [--scenario NAME] [--repeat N]
+/// Results of every scenario are compared with ones stored in golden file (test/testdata/pathfinderGolden.json
+/// by default) and mismatch or missing golden file is reported by exit code, --update-golden writes current results instead.
+/// Loading maps needs original game data, so golden file has to be generated with --update-golden where it is installed
+/// With --scenario only named scenarios are measured, option can be repeated
+/// Bucket queue of pathfinder is also compared with binary heap it replaced by flooding land of every map
+
+namespace
+{
+	const ui32 BENCHMARK_SEED = 42;
+	const int MAX_MOVEMENT = 1500;
+
+	int getMoveCost(const TerrainTile & from, const TerrainTile & dest, bool diagonal)
+	{
+		int cost = GameConstants::BASE_MOVEMENT_COST;
+		if(dest.roadType != ERoadType::NO_ROAD && from.roadType != ERoadType::NO_ROAD)
+			cost = 75;
+		else
+			cost = VLC->heroh->terrCosts[from.terType];
+
+		if(diagonal)
+			cost *= 1.414213;
+		return cost;
+	}
+
+	/// Same flood pathfinder does over land tiles, without objects and hero bonuses
+	template<typename Queue>
+	size_t floodMap(const CMap * map, CPathsInfo & info, const int3 & start, Queue & queue)
+	{
+		info.resetNodes();
+		auto initialNode = info.getNode(start, EPathfindingLayer::LAND);
+		initialNode->turns = 0;
+		initialNode->moveRemains = MAX_MOVEMENT;
+		initialNode->action = CGPathNode::NORMAL;
+		queue.push(initialNode);
+
+		std::vector<int3> neighbours;
+		size_t pops = 0;
+		while(!queue.empty())
+		{
+			auto cp = queue.top();
+			queue.pop();
+			pops++;
+			if(cp->locked)
+				continue;
+			cp->locked = true;
+
+			const TerrainTile & ct = map->getTile(cp->coord);
+			neighbours.clear();
+			CPathfinderHelper::getNeighbours(map, ct, cp->coord, neighbours, true, false);
+			for(auto & neighbour : neighbours)
+			{
+				auto dp = info.getNode(neighbour, EPathfindingLayer::LAND);
+				if(dp->locked)
+					continue;
+
+				const int cost = getMoveCost(ct, map->getTile(neighbour), cp->coord.x != neighbour.x && cp->coord.y != neighbour.y);
+				ui8 turns = cp->turns;
+				int remains = cp->moveRemains - cost;
+				if(remains < 0)
+				{
+					turns++;
+					remains = MAX_MOVEMENT - cost;
+				}
+
+				if(dp->turns > turns || (dp->turns == turns && dp->moveRemains < static_cast<ui32>(remains)))
+				{
+					dp->turns = turns;
+					dp->moveRemains = remains;
+					dp->theNodeBefore = info.getIndex(cp);
+					dp->action = CGPathNode::NORMAL;
+					queue.push(dp);
+				}
+			}
+		}
+		return pops;
+	}
+
+	std::vector<std::pair<ui8, ui32>> getLabels(const CMap * map, CPathsInfo & info)
+	{
+		std::vector<std::pair<ui8, ui32>> labels;
+		for(int z = 0; z < (map->twoLevel ? 2 : 1); z++)
+		{
+			for(int y = 0; y < map->height; y++)
+			{
+				for(int x = 0; x < map->width; x++)
+				{
+					auto node = info.getNode(int3(x, y, z), EPathfindingLayer::LAND);
+					labels.push_back(std::make_pair(node->turns, node->moveRemains));
+				}
+			}
+		}
+		return labels;
+	}
+
+	std::vector<int3> getStartTiles(const CMap * map)
+	{
+		std::vector<int3> tiles;
+		for(int z = 0; z < (map->twoLevel ? 2 : 1); z++)
+		{
+			for(int y = 0; y < map->height; y += 9)
+			{
+				for(int x = 0; x < map->width; x += 9)
+				{
+					if(map->getTile(int3(x, y, z)).terType != ETerrainType::WATER && map->getTile(int3(x, y, z)).terType != ETerrainType::ROCK)
+						tiles.push_back(int3(x, y, z));
+				}
+			}
+		}
+		return tiles;
+	}
+
+	struct MapScenario
+	{
+		std::string name;
+		std::string mapname; //empty for random maps
+		int size;
+		bool twoLevel;
+	};
+
+	struct HeroVariant
+	{
+		std::string name;
+		Bonus::BonusType bonus; //NONE if hero doesn't get additional bonus
+		bool boat;
+	};
+
+	struct Result
+	{
+		size_t expanded;
+		size_t reachable;
+		size_t memory;
+		double milliseconds;
+		std::string checksum;
+	};
+
+	GameCallbackMock gameCallback;
+
+	std::unique_ptr<CGameState> startGame(const MapScenario & scenario)
+	{
+		StartInfo si;
+		si.mode = StartInfo::NEW_GAME;
+		si.seedToBeUsed = BENCHMARK_SEED;
+		if(scenario.mapname.empty())
+		{
+			si.mapGenOptions = std::make_shared<CMapGenOptions>();
+			si.mapGenOptions->setWidth(scenario.size);
+			si.mapGenOptions->setHeight(scenario.size);
+			si.mapGenOptions->setHasTwoLevels(scenario.twoLevel);
+			si.mapGenOptions->setPlayerCount(4);
+			for(int i = 0; i < 4; i++)
+				si.mapGenOptions->setPlayerTypeForStandardPlayer(PlayerColor(i), EPlayerType::AI);
+		}
+		else
+		{
+			si.mapname = scenario.mapname;
+			for(int i = 0; i < PlayerColor::PLAYER_LIMIT_I; i++)
+			{
+				PlayerSettings & pset = si.playerInfos[PlayerColor(i)];
+				pset.color = PlayerColor(i);
+				pset.playerID = PlayerSettings::PLAYER_AI;
+				pset.compOnly = true;
+			}
+		}
+
+		//objects reach game state through callback while they are initialized
+		auto gs = make_unique<CGameState>();
+		gameCallback.setGameState(gs.get());
+		IObjectInterface::cb = &gameCallback;
+		gs->init(&si, false);
+
+		//whole map is explored, otherwise pathfinder won't go far from heroes
+		for(auto & team : gs->teams)
+		{
+			for(auto & column : team.second.fogOfWarMap)
+			{
+				for(auto & row : column)
+					std::fill(row.begin(), row.end(), 1);
+			}
+		}
+		return gs;
+	}
+
+	/// Boat is placed on nearest water tile around hero, false if there is none
+	bool embark(CGameState * gs, CGHeroInstance * hero, CGBoat * boat)
+	{
+		for(int3 dir : int3::getDirs())
+		{
+			const int3 tile = hero->getPosition(false) + dir;
+			if(!gs->map->isInTheMap(tile) || gs->map->getTile(tile).terType != ETerrainType::WATER || gs->map->getTile(tile).blocked)
+				continue;
+
+			gs->map->removeBlockVisTiles(hero);
+			hero->pos = hero->convertPosition(tile, true);
+			hero->boat = boat;
+			gs->map->addBlockVisTiles(hero);
+			return true;
+		}
+		return false;
+	}
+
+	Result measure(CGameState * gs, const CGHeroInstance * hero, int repeat)
+	{
+		Result result;
+		CPathsInfo out(int3(gs->map->width, gs->map->height, gs->map->twoLevel ? 2 : 1));
+
+		CStopWatch watch;
+		for(int i = 0; i < repeat; i++)
+			gs->calculatePaths(hero, out);
+		result.milliseconds = static_cast<double>(watch.getDiff()) / repeat;
+
+		result.expanded = result.reachable = result.memory = 0;
+		size_t checksum = 0;
+		for(ui32 index = 0; index < out.getNodesCount(); index++)
+		{
+			const CGPathNode * node = out.getNode(index);
+			if(!node)
+				continue;
+
+			result.memory += sizeof(CGPathNode);
+			if(node->locked)
+				result.expanded++;
+			if(!node->reachable())
+				continue;
+
+			result.reachable++;
+			boost::hash_combine(checksum, index);
+			boost::hash_combine(checksum, node->turns);
+			boost::hash_combine(checksum, node->moveRemains);
+			boost::hash_combine(checksum, static_cast<int>(node->action));
+		}
+		result.checksum = boost::str(boost::format("%016x") % checksum);
+		return result;
+	}
+
+	/// Floods map from tiles spread over it with both queues, false if any tile got different turns or movement
+	bool compareQueues(const std::string & name, const CMap * map)
+	{
+		const auto startTiles = getStartTiles(map);
+		CPathsInfo info(int3(map->width, map->height, (map->twoLevel ? 2 : 1)));
+		CPathNodeQueue buckets;
+		HeapQueue heap;
+
+		si64 bucketsTime = 0;
+		si64 heapTime = 0;
+		size_t pops = 0;
+		for(auto & start : startTiles)
+		{
+			auto begin = std::chrono::steady_clock::now();
+			pops += floodMap(map, info, start, heap);
+			heapTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+			const auto heapLabels = getLabels(map, info);
+
+			begin = std::chrono::steady_clock::now();
+			floodMap(map, info, start, buckets);
+			bucketsTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+			const auto bucketsLabels = getLabels(map, info);
+
+			//nodes with same key may come in different order, but every tile must get same turns and movement
+			if(bucketsLabels != heapLabels)
+			{
+				std::cout << name << ": queues differ on flood from " << start.toString() << std::endl;
+				return false;
+			}
+		}
+
+		std::cout << boost::format("%-40s %8d floods %10d popped: heap %8d us, buckets %8d us")
+			% (name + "/queues") % startTiles.size() % pops % heapTime % bucketsTime << std::endl;
+		return true;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	std::string goldenPath = "test/testdata/pathfinderGolden.json";
+	bool updateGolden = false;
+	std::set<std::string> selectedScenarios;
+	int repeat = 5;
+	for(int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--golden" && i + 1 < argc)
+			goldenPath = argv[++i];
+		else if(arg == "--update-golden")
+			updateGolden = true;
+		else if(arg == "--scenario" && i + 1 < argc)
+			selectedScenarios.insert(argv[++i]);
+		else if(arg == "--repeat" && i + 1 < argc)
+			repeat = std::max(1, std::atoi(argv[++i]));
+	}
+
+	if(!updateGolden && !boost::filesystem::exists(goldenPath))
+	{
+		std::cout << "Golden file " << goldenPath << " not found, run vcmipathbench --update-golden with game data installed to create it" << std::endl;
+		return 1;
+	}
+
+	CVcmiTestConfig config;
+
+	JsonNode golden;
+	if(!updateGolden)
+	{
+		boost::filesystem::ifstream file(goldenPath);
+		const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		golden = JsonNode(content.data(), content.size());
+	}
+
+	const std::vector<MapScenario> scenarios =
+	{
+		{"TerrainViewTest", "test/TerrainViewTest", 0, false},
+		{"random_S", "", CMapHeader::MAP_SIZE_SMALL, false},
+		{"random_M", "", CMapHeader::MAP_SIZE_MIDDLE, true},
+		{"random_L", "", CMapHeader::MAP_SIZE_LARGE, true},
+		{"random_XL", "", CMapHeader::MAP_SIZE_XLARGE, true}
+	};
+	const std::vector<HeroVariant> variants =
+	{
+		{"plain", Bonus::NONE, false},
+		{"flying", Bonus::FLYING_MOVEMENT, false},
+		{"waterWalking", Bonus::WATER_WALKING, false},
+		{"boat", Bonus::NONE, true}
+	};
+
+	int mismatches = 0;
+	JsonNode results;
+	for(auto & scenario : scenarios)
+	{
+		if(!selectedScenarios.empty() && !vstd::contains(selectedScenarios, scenario.name))
+			continue;
+
+		std::unique_ptr<CGameState> gs;
+		try
+		{
+			gs = startGame(scenario);
+		}
+		catch(const std::exception & e)
+		{
+			std::cout << scenario.name << ": failed to start game: " << e.what() << std::endl;
+			mismatches++;
+			continue;
+		}
+
+		if(!compareQueues(scenario.name, gs->map))
+			mismatches++;
+
+		if(gs->map->heroesOnMap.empty())
+			std::cout << scenario.name << ": no heroes on map, skipped" << std::endl;
+
+		for(auto & hero : gs->map->heroesOnMap)
+		{
+			for(auto & variant : variants)
+			{
+				CGBoat boat;
+				const int3 pos = hero->pos;
+				if(variant.boat && !embark(gs.get(), hero, &boat))
+					continue;
+
+				std::shared_ptr<Bonus> bonus;
+				if(variant.bonus != Bonus::NONE)
+				{
+					bonus = std::make_shared<Bonus>(Bonus::PERMANENT, variant.bonus, Bonus::OTHER, 0, 0);
+					hero->addNewBonus(bonus);
+				}
+
+				const std::string name = boost::str(boost::format("%s/%s/%s") % scenario.name % hero->name % variant.name);
+				const Result result = measure(gs.get(), hero, repeat);
+				std::cout << boost::format("%-40s %8d expanded %8d reachable %10.2f ms %8d KB")
+					% name % result.expanded % result.reachable % result.milliseconds % (result.memory / 1024) << std::endl;
+
+				JsonNode & entry = results[name];
+				entry["reachable"].Float() = result.reachable;
+				entry["checksum"].String() = result.checksum;
+
+				if(!updateGolden && golden[name] != entry)
+				{
+					if(golden[name].isNull())
+						std::cout << name << ": no golden results" << std::endl;
+					else
+						std::cout << name << ": results differ from golden ones" << std::endl;
+					mismatches++;
+				}
+
+				if(bonus)
+					hero->removeBonus(bonus);
+				if(variant.boat)
+				{
+					gs->map->removeBlockVisTiles(hero);
+					hero->pos = pos;
+					hero->boat = nullptr;
+					gs->map->addBlockVisTiles(hero);
+				}
+			}
+		}
+	}
+
+	if(updateGolden)
+	{
+		//results of scenarios that were not measured now are kept
+		if(!selectedScenarios.empty() && boost::filesystem::exists(goldenPath))
+		{
+			boost::filesystem::ifstream file(goldenPath);
+			const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			JsonNode previous(content.data(), content.size());
+			for(auto & entry : previous.Struct())
+			{
+				const std::string scenarioName = entry.first.substr(0, entry.first.find('/'));
+				if(!vstd::contains(selectedScenarios, scenarioName))
+					results[entry.first] = entry.second;
+			}
+		}
+
+		boost::filesystem::ofstream file(goldenPath);
+		file << results.toJson();
+		std::cout << "Golden results written to " << goldenPath << std::endl;
+	}
+
+	return mismatches ? 1 : 0;
+}
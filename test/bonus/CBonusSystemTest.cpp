@@ -0,0 +1,360 @@
+/*
+ * CBonusSystemTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../../lib/HeroBonus.h"
+
+class BonusSystemTest : public ::testing::Test
+{
+public:
+	CBonusSystemNode player;
+	CBonusSystemNode hero, stack;
+	CBonusSystemNode otherHero, otherStack;
+
+	BonusSystemTest()
+	{
+		hero.attachTo(&player);
+		stack.attachTo(&hero);
+		otherHero.attachTo(&player);
+		otherStack.attachTo(&otherHero);
+	}
+
+	static std::shared_ptr<Bonus> makeBonus(Bonus::BonusType type, si32 val)
+	{
+		return std::make_shared<Bonus>(Bonus::PERMANENT, type, Bonus::OTHER, val, 0);
+	}
+};
+
+TEST_F(BonusSystemTest, localChangeKeepsUnrelatedCaches)
+{
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 0);
+	EXPECT_EQ(otherStack.valOfBonuses(Bonus::MORALE), 0);
+
+	const si64 otherHeroVersion = otherHero.getTreeVersion();
+	const si64 otherStackVersion = otherStack.getTreeVersion();
+	const si64 playerVersion = player.getTreeVersion();
+
+	hero.addNewBonus(makeBonus(Bonus::MORALE, 1));
+
+	EXPECT_EQ(hero.valOfBonuses(Bonus::MORALE), 1);
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 1);
+	EXPECT_EQ(otherStack.valOfBonuses(Bonus::MORALE), 0);
+
+	EXPECT_EQ(otherHero.getTreeVersion(), otherHeroVersion);
+	EXPECT_EQ(otherStack.getTreeVersion(), otherStackVersion);
+	EXPECT_EQ(player.getTreeVersion(), playerVersion);
+}
+
+TEST_F(BonusSystemTest, ancestorChangeReachesAllDescendants)
+{
+	EXPECT_EQ(stack.valOfBonuses(Bonus::LUCK), 0);
+	EXPECT_EQ(otherStack.valOfBonuses(Bonus::LUCK), 0);
+
+	auto bonus = makeBonus(Bonus::LUCK, 2);
+	player.addNewBonus(bonus);
+
+	EXPECT_EQ(stack.valOfBonuses(Bonus::LUCK), 2);
+	EXPECT_EQ(otherStack.valOfBonuses(Bonus::LUCK), 2);
+
+	player.removeBonus(bonus);
+
+	EXPECT_EQ(stack.valOfBonuses(Bonus::LUCK), 0);
+	EXPECT_EQ(otherStack.valOfBonuses(Bonus::LUCK), 0);
+}
+
+TEST_F(BonusSystemTest, reattachingInvalidatesMovedSubtree)
+{
+	hero.addNewBonus(makeBonus(Bonus::MORALE, 1));
+	otherHero.addNewBonus(makeBonus(Bonus::MORALE, 3));
+
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 1);
+
+	stack.detachFrom(&hero);
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 0);
+
+	stack.attachTo(&otherHero);
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 3);
+	EXPECT_EQ(hero.valOfBonuses(Bonus::MORALE), 1);
+}
+
+TEST_F(BonusSystemTest, inPlaceChangeNeedsExplicitInvalidation)
+{
+	auto bonus = makeBonus(Bonus::MORALE, 1);
+	hero.addNewBonus(bonus);
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 1);
+
+	bonus->val = 2;
+	hero.nodeHasChanged();
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 2);
+
+	bonus->val = 3;
+	CBonusSystemNode::treeHasChanged();
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 3);
+}
+
+TEST_F(BonusSystemTest, concurrentQueriesOnSameNode)
+{
+	hero.addNewBonus(makeBonus(Bonus::MORALE, 1));
+	player.addNewBonus(makeBonus(Bonus::LUCK, 2));
+
+	const int queriesPerThread = 20000;
+
+	for(int threadCount : {1, 2, 4, 8})
+	{
+		//start every round from an outdated cache, so that threads also race on rebuilding it
+		stack.nodeHasChanged();
+
+		std::atomic<int> failures(0);
+		auto start = std::chrono::steady_clock::now();
+
+		boost::thread_group threads;
+		for(int i = 0; i < threadCount; i++)
+		{
+			threads.create_thread([&]()
+			{
+				for(int q = 0; q < queriesPerThread; q++)
+				{
+					if(stack.valOfBonuses(Selector::type(Bonus::MORALE), "type_MORALE") != 1)
+						failures++;
+					if(stack.valOfBonuses(Selector::type(Bonus::LUCK), "type_LUCK") != 2)
+						failures++;
+					if(stack.hasBonusOfType(Bonus::FLYING))
+						failures++;
+				}
+			});
+		}
+		threads.join_all();
+
+		//throughput is stored in test report (--gtest_output=xml) instead of console output
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		const si64 queriesPerSecond = 3LL * queriesPerThread * threadCount * 1000000 / std::max<decltype(elapsed)>(elapsed, 1);
+		RecordProperty("queriesPerSecondWith" + std::to_string(threadCount) + "Threads", static_cast<int>(std::min<si64>(queriesPerSecond, std::numeric_limits<int>::max())));
+
+		EXPECT_EQ(failures, 0);
+	}
+}
+
+TEST_F(BonusSystemTest, typeIndexedQueriesMatchFullScan)
+{
+	hero.addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::PRIMARY_SKILL, Bonus::OTHER, 2, 0, PrimarySkill::ATTACK));
+	hero.addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::PRIMARY_SKILL, Bonus::OTHER, 3, 0, PrimarySkill::DEFENSE));
+	player.addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::PRIMARY_SKILL, Bonus::OTHER, 5, 0, PrimarySkill::ATTACK));
+	stack.addNewBonus(makeBonus(Bonus::STACKS_SPEED, 1));
+	stack.addNewBonus(makeBonus(Bonus::FLYING, 0));
+
+	auto unindexed = [](Bonus::BonusType type) -> CSelector
+	{
+		return [type](const Bonus * b){ return b->type == type; };
+	};
+
+	EXPECT_EQ(Selector::type(Bonus::FLYING).getRequiredBonusType(), Bonus::FLYING);
+	EXPECT_EQ(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK).getRequiredBonusType(), Bonus::PRIMARY_SKILL);
+	EXPECT_EQ(unindexed(Bonus::FLYING).getRequiredBonusType(), -1);
+	EXPECT_EQ(Selector::type(Bonus::FLYING).Or(Selector::type(Bonus::LUCK)).getRequiredBonusType(), -1);
+
+	EXPECT_EQ(stack.valOfBonuses(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK)), 7);
+	EXPECT_EQ(stack.valOfBonuses(unindexed(Bonus::PRIMARY_SKILL).And(Selector::subtype(PrimarySkill::ATTACK))), 7);
+	EXPECT_EQ(stack.valOfBonuses(Selector::type(Bonus::PRIMARY_SKILL)), 10);
+	EXPECT_EQ(stack.valOfBonuses(Selector::type(Bonus::STACKS_SPEED)), 1);
+	EXPECT_TRUE(stack.hasBonusOfType(Bonus::FLYING));
+	EXPECT_FALSE(stack.hasBonusOfType(Bonus::MORALE));
+	EXPECT_FALSE(hero.hasBonusOfType(Bonus::FLYING));
+
+	//type beyond any indexed bucket
+	EXPECT_FALSE(stack.hasBonusOfType(Bonus::BLOCKS_RANGED_RETALIATION));
+
+	EXPECT_TRUE(Selector::matchesTypeSubtype(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK), Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK));
+	EXPECT_FALSE(Selector::matchesTypeSubtype(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK), Bonus::PRIMARY_SKILL, PrimarySkill::DEFENSE));
+	EXPECT_FALSE(Selector::matchesType(Selector::type(Bonus::FLYING), Bonus::LUCK));
+}
+
+TEST_F(BonusSystemTest, fieldSelectorsAreCachedByKey)
+{
+	hero.addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::PRIMARY_SKILL, Bonus::OTHER, 2, 0, PrimarySkill::ATTACK));
+
+	EXPECT_TRUE(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK).getKey().valid);
+	EXPECT_TRUE(Selector::all.getKey().valid);
+	EXPECT_TRUE(Selector::all.And(Selector::type(Bonus::LUCK)).getKey() == Selector::type(Bonus::LUCK).getKey());
+	EXPECT_TRUE(Selector::type(Bonus::PRIMARY_SKILL).And(Selector::subtype(PrimarySkill::ATTACK)).getKey()
+		== Selector::subtype(PrimarySkill::ATTACK).And(Selector::type(Bonus::PRIMARY_SKILL)).getKey());
+	EXPECT_FALSE(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK).getKey()
+		== Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::DEFENSE).getKey());
+	EXPECT_FALSE(Selector::type(Bonus::LUCK).Or(Selector::type(Bonus::MORALE)).getKey().valid);
+	EXPECT_FALSE(Selector::type(Bonus::LUCK).And(Selector::days(1)).getKey().valid);
+
+	auto first = stack.getBonuses(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK));
+	auto second = stack.getBonuses(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK));
+	EXPECT_EQ(first, second);
+	EXPECT_EQ(first->totalValue(), 2);
+
+	CSelector adHoc = [](const Bonus * b){ return b->type == Bonus::PRIMARY_SKILL; };
+	EXPECT_NE(stack.getBonuses(adHoc), stack.getBonuses(adHoc));
+
+	hero.addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::PRIMARY_SKILL, Bonus::OTHER, 3, 0, PrimarySkill::ATTACK));
+	auto third = stack.getBonuses(Selector::typeSubtype(Bonus::PRIMARY_SKILL, PrimarySkill::ATTACK));
+	EXPECT_NE(first, third);
+	EXPECT_EQ(third->totalValue(), 5);
+}
+
+TEST_F(BonusSystemTest, limitersDecidedInLaterPasses)
+{
+	//added before the bonus it depends on, so it can be accepted only in second pass
+	stack.addNewBonus(makeBonus(Bonus::LUCK, 1)->addLimiter(std::make_shared<HasAnotherBonusLimiter>(Bonus::MORALE)));
+	stack.addNewBonus(makeBonus(Bonus::LUCK, 4)->addLimiter(std::make_shared<HasAnotherBonusLimiter>(Bonus::FLYING)));
+	hero.addNewBonus(makeBonus(Bonus::MORALE, 2));
+
+	EXPECT_EQ(stack.valOfBonuses(Bonus::LUCK), 1);
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 2);
+	EXPECT_EQ(stack.getBonuses(Selector::all)->size(), 2u);
+
+	stack.addNewBonus(makeBonus(Bonus::FLYING, 0));
+	EXPECT_EQ(stack.valOfBonuses(Bonus::LUCK), 5);
+}
+
+TEST_F(BonusSystemTest, statisticsReportQueries)
+{
+	hero.addNewBonus(makeBonus(Bonus::MORALE, 1));
+
+	CBonusSystemStatistics::reset();
+	CBonusSystemStatistics::setEnabled(true);
+	stack.valOfBonuses(Selector::type(Bonus::MORALE));
+	stack.valOfBonuses(Selector::type(Bonus::MORALE));
+	stack.valOfBonuses(Selector::type(Bonus::LUCK), "type_LUCK");
+	CBonusSystemStatistics::setEnabled(false);
+	stack.valOfBonuses(Selector::type(Bonus::FLYING));
+
+	std::ostringstream report;
+	CBonusSystemStatistics::print(report);
+	CBonusSystemStatistics::reset();
+
+	EXPECT_NE(report.str().find("Queries: 3 cached (1 served from stored results), 0 uncached"), std::string::npos);
+	EXPECT_NE(report.str().find("2\ttype=MORALE"), std::string::npos);
+	EXPECT_NE(report.str().find("1\ttype_LUCK"), std::string::npos);
+	EXPECT_EQ(report.str().find("FLYING"), std::string::npos);
+}
+
+TEST_F(BonusSystemTest, statisticsCountQueriesOfFinishedThreads)
+{
+	hero.addNewBonus(makeBonus(Bonus::MORALE, 1));
+
+	CBonusSystemStatistics::reset();
+	CBonusSystemStatistics::setEnabled(true);
+	boost::thread_group threads;
+	for(int i = 0; i < 4; i++)
+	{
+		threads.create_thread([&]()
+		{
+			for(int q = 0; q < 10; q++)
+				stack.valOfBonuses(Selector::type(Bonus::MORALE));
+		});
+	}
+	threads.join_all();
+	stack.valOfBonuses(Selector::type(Bonus::MORALE));
+	CBonusSystemStatistics::setEnabled(false);
+
+	std::ostringstream report;
+	CBonusSystemStatistics::print(report);
+	CBonusSystemStatistics::reset();
+
+	EXPECT_NE(report.str().find("Queries: 41 cached"), std::string::npos);
+	EXPECT_NE(report.str().find("41\ttype=MORALE"), std::string::npos);
+}
+
+TEST_F(BonusSystemTest, statisticsTellAdHocSelectorsApart)
+{
+	hero.addNewBonus(makeBonus(Bonus::MORALE, 1));
+	auto positive = [](const Bonus * b)
+	{
+		return b->val > 0;
+	};
+
+	CBonusSystemStatistics::reset();
+	CBonusSystemStatistics::setEnabled(true);
+	stack.valOfBonuses(positive, "positive");
+	stack.valOfBonuses(positive, "positive");
+	stack.valOfBonuses(positive);
+	CBonusSystemStatistics::setEnabled(false);
+
+	std::ostringstream report;
+	CBonusSystemStatistics::print(report);
+	CBonusSystemStatistics::reset();
+
+	EXPECT_NE(report.str().find("2\tcaching string positive"), std::string::npos);
+	EXPECT_NE(report.str().find("statisticsTellAdHocSelectorsApart"), std::string::npos);
+}
+
+TEST_F(BonusSystemTest, overlayDoesNotTouchUnderlyingTree)
+{
+	auto morale = makeBonus(Bonus::MORALE, 1);
+	hero.addNewBonus(morale);
+	hero.addNewBonus(makeBonus(Bonus::LUCK, 2));
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 1);
+
+	const si64 stackVersion = stack.getTreeVersion();
+
+	CBonusOverlay withSpell(&stack);
+	withSpell.addBonus(makeBonus(Bonus::MORALE, 3));
+	withSpell.removeBonuses(Selector::type(Bonus::LUCK));
+
+	CBonusOverlay withoutMorale(&withSpell);
+	withoutMorale.removeBonus(morale);
+
+	EXPECT_EQ(withSpell.valOfBonuses(Bonus::MORALE), 4);
+	EXPECT_EQ(withSpell.valOfBonuses(Bonus::LUCK), 0);
+	EXPECT_EQ(withoutMorale.valOfBonuses(Bonus::MORALE), 3);
+
+	EXPECT_EQ(stack.valOfBonuses(Bonus::MORALE), 1);
+	EXPECT_EQ(stack.valOfBonuses(Bonus::LUCK), 2);
+	EXPECT_EQ(stack.getTreeVersion(), stackVersion);
+
+	//changes of the underlying tree are still visible through overlays
+	const si64 overlayVersion = withoutMorale.getTreeVersion();
+	player.addNewBonus(makeBonus(Bonus::MORALE, 10));
+	EXPECT_NE(withoutMorale.getTreeVersion(), overlayVersion);
+	EXPECT_EQ(withoutMorale.valOfBonuses(Bonus::MORALE), 13);
+}
+
+TEST_F(BonusSystemTest, emptyOverlayReturnsUnderlyingList)
+{
+	hero.addNewBonus(makeBonus(Bonus::MORALE, 1));
+
+	CBonusOverlay overlay(&stack);
+	EXPECT_EQ(overlay.getBonuses(Selector::type(Bonus::MORALE)), stack.getBonuses(Selector::type(Bonus::MORALE)));
+
+	auto added = makeBonus(Bonus::LUCK, 1);
+	overlay.addBonus(added);
+	EXPECT_EQ(overlay.valOfBonuses(Bonus::LUCK), 1);
+	overlay.removeBonus(added);
+	EXPECT_EQ(overlay.valOfBonuses(Bonus::LUCK), 0);
+}
+
+TEST_F(BonusSystemTest, overlayChecksLimitersOfAddedBonuses)
+{
+	auto luck = makeBonus(Bonus::LUCK, 2);
+	luck->addLimiter(std::make_shared<HasAnotherBonusLimiter>(Bonus::MORALE));
+
+	CBonusOverlay overlay(&stack);
+	overlay.addBonus(luck);
+	EXPECT_EQ(overlay.valOfBonuses(Bonus::LUCK), 0);
+
+	//limiter sees bonuses of the underlying tree
+	auto morale = makeBonus(Bonus::MORALE, 1);
+	hero.addNewBonus(morale);
+	EXPECT_EQ(overlay.valOfBonuses(Bonus::LUCK), 2);
+
+	//and hidden ones are not considered
+	overlay.removeBonus(morale);
+	EXPECT_EQ(overlay.valOfBonuses(Bonus::LUCK), 0);
+
+	//as well as bonuses added to the overlay itself
+	overlay.addBonus(makeBonus(Bonus::MORALE, 1));
+	EXPECT_EQ(overlay.valOfBonuses(Bonus::LUCK), 2);
+	EXPECT_EQ(stack.valOfBonuses(Bonus::LUCK), 0);
+}
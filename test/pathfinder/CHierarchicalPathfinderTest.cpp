@@ -0,0 +1,141 @@
+/*
+ * CHierarchicalPathfinderTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../../lib/CHierarchicalPathfinder.h"
+#include "../../lib/mapping/CMap.h"
+
+class HierarchicalPathfinderTest : public ::testing::Test
+{
+public:
+	HierarchicalPathfinderTest()
+	{
+		map.width = 48;
+		map.height = 40;
+		map.twoLevel = false;
+		map.initTerrain();
+		for(int x = 0; x < map.width; x++)
+		{
+			for(int y = 0; y < map.height; y++)
+				map.getTile(int3(x, y, 0)).terType = ETerrainType::GRASS;
+		}
+	}
+
+	/// Flood over whole map with same costs, result of hierarchical search can't be better
+	int exactCost(const int3 & src, const int3 & dst)
+	{
+		std::map<int3, int> costs;
+		std::set<std::pair<int, int3>> queue;
+		costs[src] = 0;
+		queue.insert(std::make_pair(0, src));
+		while(!queue.empty())
+		{
+			auto current = *queue.begin();
+			queue.erase(queue.begin());
+			if(current.second == dst)
+				return current.first;
+
+			for(int3 dir : int3::getDirs())
+			{
+				int3 next = current.second + dir;
+				if(!map.isInTheMap(next) || map.getTile(next).blocked || map.getTile(next).terType != ETerrainType::GRASS)
+					continue;
+
+				int cost = current.first + CHierarchicalPathfinder::getStepCost(map.getTile(current.second), map.getTile(next), dir.x && dir.y);
+				if(!costs.count(next) || costs[next] > cost)
+				{
+					queue.erase(std::make_pair(costs.count(next) ? costs[next] : -1, next));
+					costs[next] = cost;
+					queue.insert(std::make_pair(cost, next));
+				}
+			}
+		}
+		return -1;
+	}
+
+	void buildWall(int x, int gapY)
+	{
+		for(int y = 0; y < map.height; y++)
+			map.getTile(int3(x, y, 0)).blocked = y != gapY;
+	}
+
+	CMap map;
+};
+
+TEST_F(HierarchicalPathfinderTest, costIsCloseToExact)
+{
+	for(int y = 0; y < map.height; y++)
+		map.getTile(int3(30, y, 0)).roadType = ERoadType::DIRT_ROAD;
+	CHierarchicalPathfinder pathfinder(&map, 8);
+
+	const std::vector<std::pair<int3, int3>> queries =
+	{
+		{int3(1, 1, 0), int3(46, 38, 0)},
+		{int3(2, 30, 0), int3(44, 3, 0)},
+		{int3(9, 9, 0), int3(14, 13, 0)},
+		{int3(20, 20, 0), int3(20, 20, 0)}
+	};
+	for(auto & query : queries)
+	{
+		const int exact = exactCost(query.first, query.second);
+		const int estimate = pathfinder.getMovementCost(query.first, query.second);
+		EXPECT_GE(estimate, exact);
+		EXPECT_LE(estimate, exact * 5 / 4);
+	}
+	EXPECT_EQ(pathfinder.getMovementCost(int3(20, 20, 0), int3(20, 20, 0)), 0);
+}
+
+TEST_F(HierarchicalPathfinderTest, wallIsPassedThroughGap)
+{
+	buildWall(20, 33);
+	CHierarchicalPathfinder pathfinder(&map, 8);
+
+	const int3 src(5, 5, 0), dst(40, 5, 0);
+	const int exact = exactCost(src, dst);
+	const int cost = pathfinder.getMovementCost(src, dst);
+	ASSERT_GT(exact, 0);
+	EXPECT_GE(cost, exact);
+	EXPECT_LE(cost, exact * 5 / 4);
+	EXPECT_EQ(pathfinder.getTurnsToReach(src, dst, cost, cost), 0);
+	EXPECT_EQ(pathfinder.getTurnsToReach(src, dst, cost, 0), 1);
+	EXPECT_EQ(pathfinder.getTurnsToReach(src, dst, cost, cost - 1), 1);
+
+	//way goes through clusters of bottom row where the gap is
+	auto waypoints = pathfinder.getWaypoints(src, dst);
+	ASSERT_FALSE(waypoints.empty());
+	EXPECT_EQ(waypoints.back(), dst);
+	EXPECT_TRUE(std::any_of(waypoints.begin(), waypoints.end(), [](const int3 & tile)
+	{
+		return tile.y >= 32;
+	}));
+}
+
+TEST_F(HierarchicalPathfinderTest, updatedTilesChangeConnectivity)
+{
+	buildWall(20, 33);
+	CHierarchicalPathfinder pathfinder(&map, 8);
+	const int3 src(5, 5, 0), dst(40, 5, 0);
+	EXPECT_TRUE(pathfinder.isConnected(src, dst));
+
+	map.getTile(int3(20, 33, 0)).blocked = true;
+	pathfinder.updateTiles({int3(20, 33, 0)});
+	EXPECT_FALSE(pathfinder.isConnected(src, dst));
+	EXPECT_TRUE(pathfinder.getWaypoints(src, dst).empty());
+	EXPECT_EQ(pathfinder.getTurnsToReach(src, dst, 1500, 1500), -1);
+
+	map.getTile(int3(20, 2, 0)).blocked = false;
+	pathfinder.updateTiles({int3(20, 2, 0)});
+	EXPECT_TRUE(pathfinder.isConnected(src, dst));
+	EXPECT_EQ(pathfinder.getMovementCost(src, dst), CHierarchicalPathfinder(&map, 8).getMovementCost(src, dst));
+
+	map.getTile(int3(40, 5, 0)).terType = ETerrainType::WATER;
+	pathfinder.updateTiles({int3(40, 5, 0)});
+	EXPECT_FALSE(pathfinder.isConnected(src, dst));
+}
@@ -0,0 +1,68 @@
+/*
+ * CPathNodeQueueTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../../lib/CPathfinder.h"
+#include "../../lib/CRandomGenerator.h"
+#include "HeapQueue.h"
+
+TEST(PathNodeQueueTest, popsNodesInHeapOrder)
+{
+	CRandomGenerator rand;
+	rand.setSeed(42);
+	CPathsInfo info(int3(64, 64, 1));
+	CPathNodeQueue queue;
+	HeapQueue heap;
+
+	auto makeNode = [&](int index, ui8 turns, ui32 moveRemains)
+	{
+		auto node = info.getNode(int3(index % 64, index / 64, 0), EPathfindingLayer::LAND);
+		node->turns = turns;
+		node->moveRemains = moveRemains;
+		return node;
+	};
+
+	//seeds are pushed in arbitrary order, like when repairing paths
+	int index = 0;
+	for(; index < 200; index++)
+	{
+		auto node = makeNode(index, rand.nextInt(0, 5), rand.nextInt(0, 2000));
+		queue.push(node);
+		heap.push(node);
+	}
+
+	//then every push is not better than last popped node
+	while(!heap.empty())
+	{
+		ASSERT_EQ(queue.size(), heap.size());
+		auto expected = heap.top();
+		auto actual = queue.top();
+		heap.pop();
+		queue.pop();
+		ASSERT_EQ(actual->turns, expected->turns);
+		ASSERT_EQ(actual->moveRemains, expected->moveRemains);
+
+		for(int i = rand.nextInt(0, 2); i > 0 && index < 64 * 64; i--, index++)
+		{
+			ui8 turns = expected->turns + rand.nextInt(0, 2);
+			ui32 moveRemains = turns == expected->turns ? rand.nextInt(0, expected->moveRemains) : rand.nextInt(0, 2000);
+			auto node = makeNode(index, turns, moveRemains);
+			queue.push(node);
+			heap.push(node);
+		}
+	}
+	EXPECT_TRUE(queue.empty());
+
+	queue.push(makeNode(0, 3, 100));
+	queue.clear();
+	EXPECT_TRUE(queue.empty());
+	queue.push(makeNode(0, 1, 100));
+	EXPECT_EQ(queue.top()->turns, 1);
+}
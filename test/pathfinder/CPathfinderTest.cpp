@@ -0,0 +1,282 @@
+/*
+ * CPathfinderTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../mock/mock_IGameCallback.h"
+#include "../../lib/CGameState.h"
+#include "../../lib/CPathfinder.h"
+#include "../../lib/CPlayerState.h"
+#include "../../lib/StartInfo.h"
+#include "../../lib/VCMI_Lib.h"
+#include "../../lib/mapObjects/CGHeroInstance.h"
+#include "../../lib/mapObjects/CObjectClassesHandler.h"
+#include "../../lib/mapObjects/MiscObjects.h"
+#include "../../lib/mapping/CMap.h"
+
+class PathfinderTest : public ::testing::Test
+{
+public:
+	static void SetUpTestCase()
+	{
+		StartInfo si;
+		si.mode = StartInfo::NEW_GAME;
+		si.seedToBeUsed = 42;
+		si.mapname = "test/TerrainViewTest";
+		for(int i = 0; i < PlayerColor::PLAYER_LIMIT_I; i++)
+		{
+			PlayerSettings & pset = si.playerInfos[PlayerColor(i)];
+			pset.color = PlayerColor(i);
+			pset.playerID = PlayerSettings::PLAYER_AI;
+			pset.compOnly = true;
+		}
+
+		//objects reach game state through callback while they are initialized
+		gameCallback = make_unique<GameCallbackMock>();
+		gs = make_unique<CGameState>();
+		gameCallback->setGameState(gs.get());
+		IObjectInterface::cb = gameCallback.get();
+		gs->init(&si, false);
+
+		//whole map is explored, otherwise pathfinder won't go far from heroes
+		for(auto & team : gs->teams)
+		{
+			for(auto & column : team.second.fogOfWarMap)
+			{
+				for(auto & row : column)
+					std::fill(row.begin(), row.end(), 1);
+			}
+		}
+	}
+
+	static void TearDownTestCase()
+	{
+		gs.reset();
+		IObjectInterface::cb = nullptr;
+		gameCallback.reset();
+	}
+
+	std::unique_ptr<CPathsInfo> makePaths() const
+	{
+		return make_unique<CPathsInfo>(int3(gs->map->width, gs->map->height, gs->map->twoLevel ? 2 : 1));
+	}
+
+	/// Every node must be reached in same number of turns with same movement left, predecessors may differ
+	/// when several paths are equally good
+	void expectSamePaths(const CPathsInfo & actual, const CPathsInfo & expected, const std::string & context) const
+	{
+		ASSERT_EQ(actual.getNodesCount(), expected.getNodesCount());
+		for(ui32 index = 0; index < expected.getNodesCount(); index++)
+		{
+			const CGPathNode * expectedNode = expected.getNode(index);
+			const CGPathNode * actualNode = actual.getNode(index);
+			const bool expectedReachable = expectedNode && expectedNode->reachable();
+			const bool actualReachable = actualNode && actualNode->reachable();
+			ASSERT_EQ(actualReachable, expectedReachable) << context << ", node " << index;
+			if(!expectedReachable)
+				continue;
+
+			ASSERT_EQ(actualNode->turns, expectedNode->turns) << context << ", " << expectedNode->coord.toString();
+			ASSERT_EQ(actualNode->moveRemains, expectedNode->moveRemains) << context << ", " << expectedNode->coord.toString();
+			ASSERT_EQ(actualNode->action, expectedNode->action) << context << ", " << expectedNode->coord.toString();
+		}
+	}
+
+	/// Every third tile of map, so destinations are spread over all terrains and both levels
+	std::vector<int3> getDestinations() const
+	{
+		std::vector<int3> ret;
+		for(int z = 0; z < (gs->map->twoLevel ? 2 : 1); z++)
+		{
+			for(int x = 0; x < gs->map->width; x++)
+			{
+				for(int y = 0; y < gs->map->height; y++)
+				{
+					if((x + y) % 3 == 0)
+						ret.push_back(int3(x, y, z));
+				}
+			}
+		}
+		return ret;
+	}
+
+	/// Search for single destination must find path as good as search over whole map
+	void expectSameAsFullPaths(const CGHeroInstance * hero, const std::vector<int3> & destinations, const std::string & context) const
+	{
+		auto full = makePaths();
+		auto single = makePaths();
+		gs->calculatePaths(hero, *full);
+		for(const int3 & dst : destinations)
+		{
+			const CGPathNode * expected = full->getPathInfo(dst);
+			const bool reachable = gs->calculatePath(hero, dst, *single);
+			ASSERT_EQ(reachable, expected->reachable()) << context << ", " << dst.toString();
+			if(!reachable)
+				continue;
+
+			const CGPathNode * actual = single->getPathInfo(dst);
+			ASSERT_EQ(actual->turns, expected->turns) << context << ", " << dst.toString();
+			ASSERT_EQ(actual->moveRemains, expected->moveRemains) << context << ", " << dst.toString();
+		}
+	}
+
+	/// Object on free land tile from candidates, nullptr if none fits
+	CGObjectInstance * addObject(Obj type, si32 subtype, const std::vector<int3> & candidates) const
+	{
+		auto handler = VLC->objtypeh->getHandlerFor(type, subtype);
+		for(const int3 & pos : candidates)
+		{
+			auto templates = handler->getTemplates(gs->map->getTile(pos).terType);
+			if(templates.empty())
+				continue;
+
+			std::unique_ptr<CGObjectInstance> obj(handler->create(templates.front()));
+			obj->pos = pos;
+			std::set<int3> tiles = obj->getBlockedPos();
+			tiles.insert(obj->visitablePos());
+			const bool occupied = vstd::contains_if(tiles, [&](const int3 & tile)
+			{
+				if(!gs->map->isInTheMap(tile))
+					return true;
+				const TerrainTile & t = gs->map->getTile(tile);
+				return !t.isClear() || t.visitable || t.isWater();
+			});
+			if(occupied)
+				continue;
+
+			obj->id = ObjectInstanceID(gs->map->objects.size());
+			obj->instanceName = boost::str(boost::format("%s_%d") % obj->typeName % obj->id.getNum());
+			gs->map->addNewObject(obj.get());
+			obj->initObj(gs->getRandomGenerator());
+			return obj.release();
+		}
+		return nullptr;
+	}
+
+	void removeObject(CGObjectInstance * obj) const
+	{
+		gs->map->removeBlockVisTiles(obj);
+		gs->map->instanceNames.erase(obj->instanceName);
+		gs->map->objects[obj->id.getNum()].dellNull();
+	}
+
+	static std::unique_ptr<GameCallbackMock> gameCallback;
+	static std::unique_ptr<CGameState> gs;
+};
+
+std::unique_ptr<GameCallbackMock> PathfinderTest::gameCallback;
+std::unique_ptr<CGameState> PathfinderTest::gs;
+
+TEST_F(PathfinderTest, repairedPathsMatchFullCalculation)
+{
+	ASSERT_FALSE(gs->map->heroesOnMap.empty());
+	const CGHeroInstance * hero = gs->map->heroesOnMap.front();
+
+	//objects nearest to hero change paths of most nodes
+	std::vector<CGObjectInstance *> objects;
+	for(auto & obj : gs->map->objects)
+	{
+		if(obj && obj->ID != Obj::HERO && obj->pos.z == hero->pos.z)
+			objects.push_back(obj.get());
+	}
+	ASSERT_FALSE(objects.empty());
+	std::sort(objects.begin(), objects.end(), [&](const CGObjectInstance * lhs, const CGObjectInstance * rhs)
+	{
+		return lhs->visitablePos().dist2dSQ(hero->pos) < rhs->visitablePos().dist2dSQ(hero->pos);
+	});
+	vstd::erase_if(objects, [&](const CGObjectInstance * obj)
+	{
+		return obj != objects.front() && obj->visitablePos().dist2dSQ(hero->pos) > 100;
+	});
+
+	auto repaired = makePaths();
+	auto full = makePaths();
+	gs->calculatePaths(hero, *repaired);
+
+	auto check = [&](CGObjectInstance * obj, const std::string & context)
+	{
+		std::unordered_set<int3, ShashInt3> changedTiles;
+		for(auto & tile : obj->getBlockedPos())
+			changedTiles.insert(tile);
+		changedTiles.insert(obj->visitablePos());
+
+		gs->updatePaths(hero, *repaired, changedTiles);
+		gs->calculatePaths(hero, *full);
+		expectSamePaths(*repaired, *full, context + " " + obj->getObjectName() + " at " + obj->visitablePos().toString());
+	};
+
+	for(auto obj : objects)
+	{
+		gs->map->removeBlockVisTiles(obj);
+		check(obj, "removed");
+		gs->map->addBlockVisTiles(obj);
+		check(obj, "restored");
+	}
+}
+
+TEST_F(PathfinderTest, pathToDestinationMatchesFullCalculation)
+{
+	ASSERT_FALSE(gs->map->heroesOnMap.empty());
+	CGHeroInstance * hero = gs->map->heroesOnMap.front();
+	const auto destinations = getDestinations();
+
+	expectSameAsFullPaths(hero, destinations, "plain");
+
+	//cheaper steps of flying and water walking hero must not make estimate to destination too high
+	for(auto type : {Bonus::FLYING_MOVEMENT, Bonus::WATER_WALKING})
+	{
+		auto bonus = std::make_shared<Bonus>(Bonus::PERMANENT, type, Bonus::OTHER, 0, 0);
+		hero->addNewBonus(bonus);
+		expectSameAsFullPaths(hero, destinations, type == Bonus::FLYING_MOVEMENT ? "flying" : "water walking");
+		hero->removeBonus(bonus);
+	}
+}
+
+TEST_F(PathfinderTest, pathThroughTeleportMatchesFullCalculation)
+{
+	ASSERT_FALSE(gs->map->heroesOnMap.empty());
+	const CGHeroInstance * hero = gs->map->heroesOnMap.front();
+
+	//entrance next to hero and exit as far as possible, so teleport is shortcut to most of map
+	std::vector<int3> candidates;
+	for(int x = 0; x < gs->map->width; x++)
+	{
+		for(int y = 0; y < gs->map->height; y++)
+			candidates.push_back(int3(x, y, hero->pos.z));
+	}
+	std::sort(candidates.begin(), candidates.end(), [&](const int3 & lhs, const int3 & rhs)
+	{
+		return lhs.dist2dSQ(hero->pos) < rhs.dist2dSQ(hero->pos);
+	});
+	CGObjectInstance * entrance = addObject(Obj::MONOLITH_TWO_WAY, 0, candidates);
+	ASSERT_TRUE(entrance != nullptr);
+	CGObjectInstance * exit = addObject(Obj::MONOLITH_TWO_WAY, 0, std::vector<int3>(candidates.rbegin(), candidates.rend()));
+	ASSERT_TRUE(exit != nullptr);
+	const TeleportChannelID channel = dynamic_cast<CGTeleport *>(entrance)->channel;
+	ASSERT_EQ(dynamic_cast<CGTeleport *>(exit)->channel, channel);
+
+	//teleport may lead to any destination, tiles around exit are reached through it
+	auto destinations = getDestinations();
+	for(const int3 & monolith : {entrance->visitablePos(), exit->visitablePos()})
+	{
+		for(int dx = -2; dx <= 2; dx++)
+		{
+			for(int dy = -2; dy <= 2; dy++)
+			{
+				if(gs->map->isInTheMap(monolith + int3(dx, dy, 0)))
+					destinations.push_back(monolith + int3(dx, dy, 0));
+			}
+		}
+	}
+	expectSameAsFullPaths(hero, destinations, "teleport");
+
+	removeObject(exit);
+	removeObject(entrance);
+	gs->map->teleportChannels.erase(channel);
+}
@@ -0,0 +1,91 @@
+/*
+ * CPathsInfoTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../../lib/CPathfinder.h"
+
+class PathsInfoTest : public ::testing::Test
+{
+public:
+	PathsInfoTest()
+		: info(int3(8, 6, 2))
+	{
+	}
+
+	CGPathNode * reach(const int3 & coord, EPathfindingLayer layer, const CGPathNode * before, ui8 turns = 0)
+	{
+		CGPathNode * node = info.getNode(coord, layer);
+		node->turns = turns;
+		node->moveRemains = 1000;
+		node->action = CGPathNode::NORMAL;
+		node->theNodeBefore = before ? info.getIndex(before) : CGPathNode::NO_NODE;
+		return node;
+	}
+
+	CPathsInfo info;
+};
+
+TEST_F(PathsInfoTest, layersAreAllocatedOnDemand)
+{
+	EXPECT_TRUE(info.hasLayer(EPathfindingLayer::LAND));
+	EXPECT_FALSE(info.hasLayer(EPathfindingLayer::SAIL));
+	EXPECT_FALSE(info.hasLayer(EPathfindingLayer::AIR));
+
+	const CGPathNode * node = info.getPathInfo(int3(3, 4, 1));
+	EXPECT_EQ(node->coord, int3(3, 4, 1));
+	EXPECT_EQ(node->layer, EPathfindingLayer::LAND);
+	EXPECT_FALSE(node->reachable());
+
+	CGPathNode * airNode = info.getNode(int3(7, 5, 1), EPathfindingLayer::AIR);
+	EXPECT_TRUE(info.hasLayer(EPathfindingLayer::AIR));
+	EXPECT_FALSE(info.hasLayer(EPathfindingLayer::SAIL));
+	EXPECT_EQ(airNode->coord, int3(7, 5, 1));
+	EXPECT_EQ(airNode->layer, EPathfindingLayer::AIR);
+	EXPECT_EQ(info.getNode(info.getIndex(airNode)), airNode);
+}
+
+TEST_F(PathsInfoTest, pathFollowsNodesAcrossLayers)
+{
+	auto start = reach(int3(1, 1, 0), EPathfindingLayer::LAND, nullptr);
+	auto boat = reach(int3(2, 1, 0), EPathfindingLayer::SAIL, start);
+	auto shore = reach(int3(3, 2, 0), EPathfindingLayer::LAND, boat, 1);
+
+	CGPath path;
+	ASSERT_TRUE(info.getPath(path, shore->coord));
+	ASSERT_EQ(path.nodes.size(), 3);
+	EXPECT_EQ(path.endPos(), int3(3, 2, 0));
+	EXPECT_EQ(path.nodes[1].layer, EPathfindingLayer::SAIL);
+	EXPECT_EQ(path.startPos(), int3(1, 1, 0));
+
+	//unreachable land node falls back to sail one
+	EXPECT_EQ(info.getPathInfo(boat->coord), boat);
+	EXPECT_FALSE(info.getPath(path, int3(5, 5, 0)));
+}
+
+TEST_F(PathsInfoTest, resetDoesNotLeaveStaleNodes)
+{
+	auto start = reach(int3(0, 0, 0), EPathfindingLayer::LAND, nullptr);
+	auto next = reach(int3(1, 0, 0), EPathfindingLayer::LAND, start);
+	next->accessible = CGPathNode::VISITABLE;
+	next->locked = true;
+
+	info.resetNodes();
+	const CGPathNode * node = info.getPathInfo(int3(1, 0, 0));
+	EXPECT_FALSE(node->reachable());
+	EXPECT_FALSE(node->locked);
+	EXPECT_EQ(node->accessible, CGPathNode::NOT_SET);
+	EXPECT_EQ(node->theNodeBefore, CGPathNode::NO_NODE);
+
+	//stamps have to be dropped once counter wraps around
+	reach(int3(1, 0, 0), EPathfindingLayer::LAND, reach(int3(0, 0, 0), EPathfindingLayer::LAND, nullptr));
+	for(int i = 0; i <= std::numeric_limits<ui16>::max(); i++)
+		info.resetNodes();
+	EXPECT_FALSE(info.getPathInfo(int3(1, 0, 0))->reachable());
+}
@@ -0,0 +1,30 @@
+/*
+ * HeapQueue.h, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#pragma once
+
+#include "../../lib/CPathfinder.h"
+
+#include <boost/heap/priority_queue.hpp>
+
+/// Queue pathfinder used before buckets, kept as reference
+struct NodeComparer
+{
+	bool operator()(const CGPathNode * lhs, const CGPathNode * rhs) const
+	{
+		if(rhs->turns > lhs->turns)
+			return false;
+		else if(rhs->turns == lhs->turns && rhs->moveRemains <= lhs->moveRemains)
+			return false;
+
+		return true;
+	}
+};
+typedef boost::heap::priority_queue<CGPathNode *, boost::heap::compare<NodeComparer>> HeapQueue;
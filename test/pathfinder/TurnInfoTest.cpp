@@ -0,0 +1,94 @@
+/*
+ * TurnInfoTest.cpp, part of VCMI engine
+ *
+ * Authors: listed in file AUTHORS in main folder
+ *
+ * License: GNU General Public License v2.0 or later
+ * Full text of license available in license.txt file, in main folder
+ *
+ */
+
+#include "StdInc.h"
+#include "../../lib/CPathfinder.h"
+#include "../../lib/CRandomGenerator.h"
+#include "../../lib/mapObjects/CGHeroInstance.h"
+#include "../../lib/mapObjects/MiscObjects.h"
+#include "../../lib/mapping/CMapDefines.h"
+
+namespace
+{
+	/// Movement cost as it was calculated before cost tables, without last tile check
+	int referenceMovementCost(const CGHeroInstance * h, const int3 & src, const int3 & dst, const TerrainTile * ct, const TerrainTile * dt, const int remainingMovePoints, const TurnInfo * ti)
+	{
+		int ret = h->getTileCost(*dt, *ct, ti);
+		if(dt->blocked && ti->hasBonusOfType(Bonus::FLYING_MOVEMENT))
+		{
+			ret *= (100.0 + ti->valOfBonuses(Bonus::FLYING_MOVEMENT)) / 100.0;
+		}
+		else if(dt->terType == ETerrainType::WATER)
+		{
+			if(h->boat && ct->hasFavorableWinds() && dt->hasFavorableWinds())
+				ret *= 0.666;
+			else if(!h->boat && ti->hasBonusOfType(Bonus::WATER_WALKING))
+			{
+				ret *= (100.0 + ti->valOfBonuses(Bonus::WATER_WALKING)) / 100.0;
+			}
+		}
+
+		if(src.x != dst.x && src.y != dst.y)
+		{
+			int old = ret;
+			ret *= 1.414213;
+			if(ret > remainingMovePoints && remainingMovePoints >= old)
+				return remainingMovePoints;
+		}
+		return ret;
+	}
+
+	void randomizeTile(CRandomGenerator & rand, TerrainTile & tile, bool allowRock)
+	{
+		tile.terType = static_cast<ETerrainType::EETerrainType>(rand.nextInt(0, allowRock ? ETerrainType::ROCK : ETerrainType::WATER));
+		tile.roadType = static_cast<ERoadType::ERoadType>(rand.nextInt(0, 3) == 0 ? rand.nextInt(ERoadType::DIRT_ROAD, ERoadType::COBBLESTONE_ROAD) : ERoadType::NO_ROAD);
+		tile.blocked = rand.nextInt(0, 3) == 0;
+		tile.extTileFlags = rand.nextInt(0, 1) ? 128 : 0;
+	}
+}
+
+TEST(TurnInfoTest, movementCostTableMatchesDirectCalculation)
+{
+	CRandomGenerator rand;
+	rand.setSeed(1337);
+	CGBoat boat;
+
+	for(int scenario = 0; scenario < 50; scenario++)
+	{
+		CGHeroInstance hero;
+		if(rand.nextInt(0, 1))
+			hero.addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::FLYING_MOVEMENT, Bonus::OTHER, rand.nextInt(0, 40), 0));
+		if(rand.nextInt(0, 1))
+			hero.addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::WATER_WALKING, Bonus::OTHER, rand.nextInt(0, 40), 0));
+		if(rand.nextInt(0, 1))
+			hero.addNewBonus(std::make_shared<Bonus>(Bonus::PERMANENT, Bonus::NO_TERRAIN_PENALTY, Bonus::OTHER, 0, 0, rand.nextInt(0, ETerrainType::WATER)));
+		hero.secSkills.push_back(std::make_pair(SecondarySkill(SecondarySkill::PATHFINDING), static_cast<ui8>(rand.nextInt(0, 3))));
+		hero.boat = rand.nextInt(0, 1) ? &boat : nullptr;
+
+		TurnInfo ti(&hero);
+		TurnInfo referenceTi(&hero);
+		const int3 src(5, 5, 0);
+
+		for(int move = 0; move < 500; move++)
+		{
+			TerrainTile ct, dt;
+			randomizeTile(rand, ct, false);
+			randomizeTile(rand, dt, true);
+			const int3 dst = src + int3(rand.nextInt(-1, 1), rand.nextInt(-1, 1), 0);
+			if(dst == src)
+				continue;
+
+			const int remains = rand.nextInt(0, 2000);
+			const int expected = referenceMovementCost(&hero, src, dst, &ct, &dt, remains, &referenceTi);
+			ASSERT_EQ(CPathfinderHelper::getMovementCost(&hero, src, dst, &ct, &dt, remains, &ti, false), expected)
+				<< "scenario " << scenario << ", move " << move;
+		}
+	}
+}